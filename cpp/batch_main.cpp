@@ -0,0 +1,449 @@
+/* VERSION information is kept in utils.h. Please update when a new version is released */
+
+#include "shared/utils.h"
+#include "non_iid/non_iid_test_run.h"
+#include "non_iid/non_iid_estimates.h"
+#include "shared/TestRunUtils.h"
+
+#include <getopt.h>
+#include <limits.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <openssl/sha.h>
+
+// Tasks are created roughly longest first, so that the long running estimators start early.
+static const non_iid_estimator taskOrder[EST_COUNT] = {EST_TUPLE, EST_MULTI_MMC, EST_LZ78Y, EST_MULTI_MCW, EST_LAG, EST_COMPRESSION, EST_MARKOV, EST_COLLISION, EST_MCV};
+
+struct batch_input {
+    int line;                       // manifest line number
+    string file_path;
+    string outputfilename;
+    int word_size;                  // 0 if not specified
+    sample_format_t format;
+    unsigned long subsetIndex;
+    unsigned long subsetSize;
+    size_t memEstimate;             // bytes currently reserved for this input
+
+    data_t data;
+    NonIidTestRun testRun;
+    non_iid_estimates estimates;
+};
+
+struct batch_state {
+    vector<batch_input*> inputs;
+    size_t next;                    // first input that has not been admitted yet
+    size_t memLimit;
+    size_t memInUse;
+    bool initial_entropy;
+    bool all_bits;
+    bool quietMode;
+    string timestamp;
+    int failures;
+};
+
+[[ noreturn ]] void print_usage() {
+    printf("Usage is: ea_batch [-i|-c] [-a|-t] [-q] [-m <MiB>] <manifest>\n\n");
+    printf("\t <manifest>: Text file listing one input per line, as\n");
+    printf("\t\t <file_name> [bits_per_symbol] [-l <index>,<samples>] [-f <format>] [-o <output.json>]\n");
+    printf("\t\t where the fields have the same meaning as for ea_non_iid. Blank lines and lines starting with '#' are ignored.\n");
+    printf("\t\t The JSON result of each input is written to <output.json>, which defaults to '<file_name>.json'\n");
+    printf("\t\t (or '<file_name>.<index>.json' with -l).\n");
+    printf("\t [-i|-c]: '-i' for initial entropy estimate, '-c' for conditioned sequential dataset entropy estimate. The initial entropy estimate is the default.\n");
+    printf("\t [-a|-t]: '-a' produces the 'H_bitstring' assessment using all read bits, '-t' truncates the bitstring used to produce the `H_bitstring` assessment to %d bits. Test all data by default.\n", MIN_SIZE);
+    printf("\t -q: Quiet mode, no per-input summary.\n");
+    printf("\t -m <MiB>: Approximate memory budget. Inputs are only started while their estimated working set fits\n");
+    printf("\t in the budget (one input is always allowed to run). By default, 3/4 of the physical memory is used.\n");
+    printf("\n");
+    printf("\t All the inputs share one pool of threads: each (input, estimator, bitstring/literal) combination is a\n");
+    printf("\t separate task, so several inputs are assessed concurrently. The results are the same as those of\n");
+    printf("\t running 'ea_non_iid [-i|-c] [-a|-t] -o <output.json>' on each input.\n");
+    printf("\n");
+    printf("\t --version: Prints tool version information");
+    printf("\n");
+    exit(-1);
+}
+
+static bool parse_manifest_line(const string &text, int lineNumber, batch_input *in) {
+    istringstream fields(text);
+    string field;
+    unsigned long long inint;
+    char *nextOption;
+    bool haveOutput = false;
+
+    in->line = lineNumber;
+    in->word_size = 0;
+    in->format = FORMAT_BYTE;
+    in->subsetIndex = ULONG_MAX;
+    in->subsetSize = 0;
+
+    fields >> in->file_path;
+
+    if (in->file_path == "-") {
+        printf("Manifest line %d: standard input can't be used in a manifest.\n", lineNumber);
+        return false;
+    }
+
+    while (fields >> field) {
+        if (field == "-l") {
+            if (!(fields >> field)) break;
+            errno = 0;
+            inint = strtoull(field.c_str(), &nextOption, 0);
+            if ((inint > ULONG_MAX) || (errno == EINVAL) || (nextOption == NULL) || (*nextOption != ',')) {
+                printf("Manifest line %d: Error on index/samples.\n", lineNumber);
+                return false;
+            }
+            in->subsetIndex = inint;
+            inint = strtoull(nextOption + 1, NULL, 0);
+            if ((inint > ULONG_MAX) || (errno == EINVAL)) {
+                printf("Manifest line %d: Error on index/samples.\n", lineNumber);
+                return false;
+            }
+            in->subsetSize = inint;
+        } else if (field == "-f") {
+            if (!(fields >> field)) break;
+            if (!parse_sample_format(field.c_str(), &in->format)) {
+                printf("Manifest line %d: Unknown input format.\n", lineNumber);
+                return false;
+            }
+        } else if (field == "-o") {
+            if (!(fields >> in->outputfilename)) break;
+            haveOutput = true;
+        } else if ((in->word_size == 0) && (field.find_first_not_of("0123456789") == string::npos)) {
+            inint = atoi(field.c_str());
+            if (inint < 1 || inint > 8) {
+                printf("Manifest line %d: Invalid bits per symbol.\n", lineNumber);
+                return false;
+            }
+            in->word_size = inint;
+        } else {
+            printf("Manifest line %d: Unexpected field '%s'.\n", lineNumber, field.c_str());
+            return false;
+        }
+    }
+
+    if (!fields.eof()) {
+        printf("Manifest line %d: Missing option argument.\n", lineNumber);
+        return false;
+    }
+
+    if (!haveOutput) {
+        in->outputfilename = in->file_path;
+        if (in->subsetSize != 0) in->outputfilename += "." + to_string(in->subsetIndex);
+        in->outputfilename += ".json";
+    }
+
+    return true;
+}
+
+// The equivalent ea_non_iid command line, which is recorded in the JSON output
+static string input_command_line(const batch_state *st, const batch_input *in) {
+    static const char *formatNames[] = {"byte", "msb", "lsb", "nibble"};
+    string commandline = "ea_non_iid";
+
+    commandline += st->initial_entropy ? " -i" : " -c";
+    commandline += st->all_bits ? " -a" : " -t";
+    if (in->format != FORMAT_BYTE) commandline += string(" -f ") + formatNames[in->format];
+    if (in->subsetSize != 0) commandline += " -l " + to_string(in->subsetIndex) + "," + to_string(in->subsetSize);
+    commandline += " -o " + in->outputfilename + " " + in->file_path;
+    if (in->word_size != 0) commandline += " " + to_string(in->word_size);
+
+    return commandline;
+}
+
+// Approximate peak memory use of an input of len samples, whose bitstring has blen bits:
+// the raw, symbol and bitstring representations, and the suffix and LCP arrays of SAalgs, which is the largest
+// working set of the estimators.
+static size_t input_memory(long len, long blen, int word_size, sample_format_t format) {
+    long saLen = max(len, blen);
+    size_t bytes;
+
+    bytes = len / samples_per_byte(format) + len;
+    if (word_size > 1) bytes += blen;
+    bytes += 8 * packed_words(blen);
+    bytes += ((saLen < INT_MAX) ? 16 : 32) * (size_t)saLen;
+
+    return bytes;
+}
+
+// Estimate the memory of an input before it is read, from the size of the file
+static size_t estimate_input_memory(const batch_state *st, const batch_input *in) {
+    struct stat statbuf;
+    long len;
+    int word_size;
+
+    if (in->subsetSize != 0) len = in->subsetSize;
+    else if (stat(in->file_path.c_str(), &statbuf) == 0) len = statbuf.st_size * samples_per_byte(in->format);
+    else len = 0;
+
+    word_size = (in->word_size != 0) ? in->word_size : format_sample_bits(in->format);
+    if (!st->all_bits) return input_memory(len, min((long)word_size * len, (long)MIN_SIZE), word_size, in->format);
+    return input_memory(len, (long)word_size * len, word_size, in->format);
+}
+
+static void write_test_run(batch_input *in) {
+    ofstream output;
+    output.open(in->outputfilename);
+    output << in->testRun.GetAsJson();
+    output.close();
+}
+
+static void process_input(batch_state *st, batch_input *in);
+
+// Start the inputs (in manifest order) that fit in the memory budget. One input is always allowed to run, so
+// that an input larger than the budget is still assessed (alone).
+static void admit_inputs(batch_state *st) {
+    vector<batch_input*> admitted;
+
+    #pragma omp critical(batchAdmission)
+    {
+        while (st->next < st->inputs.size()) {
+            batch_input *in = st->inputs[st->next];
+
+            if ((st->memInUse > 0) && (st->memInUse + in->memEstimate > st->memLimit)) break;
+
+            st->memInUse += in->memEstimate;
+            st->next++;
+            admitted.push_back(in);
+        }
+    }
+
+    for (size_t i = 0; i < admitted.size(); i++) {
+        batch_input *in = admitted[i];
+
+        #pragma omp task firstprivate(st, in)
+        process_input(st, in);
+    }
+}
+
+// Release the memory reserved for an input, and start the inputs that now fit
+static void retire_input(batch_state *st, batch_input *in) {
+    #pragma omp critical(batchAdmission)
+    {
+        st->memInUse -= in->memEstimate;
+        in->memEstimate = 0;
+    }
+
+    admit_inputs(st);
+}
+
+// Read one input, run all its estimators as separate tasks, then write its JSON result
+static void process_input(batch_state *st, batch_input *in) {
+    char hash[2*SHA256_DIGEST_LENGTH+1];
+    data_t *dp = &in->data;
+
+    in->testRun.timestamp = st->timestamp;
+    in->testRun.commandline = input_command_line(st, in);
+    in->testRun.filename = in->file_path;
+
+    dp->word_size = in->word_size;
+    dp->format = in->format;
+
+    // The file is hashed while it is being read
+    bool readSuccess = read_file_subset(in->file_path.c_str(), dp, in->subsetIndex, in->subsetSize, &in->testRun, hash);
+    in->testRun.sha256 = hash;
+
+    if (!readSuccess) {
+        write_test_run(in);
+        #pragma omp critical(batchOutput)
+        {
+            printf("%s: Error reading file.\n", in->file_path.c_str());
+            st->failures++;
+        }
+        retire_input(st, in);
+        return;
+    }
+
+    if (dp->alph_size <= 1) {
+        in->testRun.errorLevel = -1;
+        in->testRun.errorMsg = "Symbol alphabet consists of 1 symbol. No entropy awarded...";
+        write_test_run(in);
+        #pragma omp critical(batchOutput)
+        {
+            printf("%s: Symbol alphabet consists of 1 symbol. No entropy awarded...\n", in->file_path.c_str());
+            st->failures++;
+        }
+        free_data(dp);
+        retire_input(st, in);
+        return;
+    }
+
+    if (!st->all_bits && (dp->blen > MIN_SIZE)) dp->blen = MIN_SIZE;
+
+    // Now that the data is known, replace the estimate made from the file size (e.g., for compressed files)
+    #pragma omp critical(batchAdmission)
+    {
+        size_t actual = input_memory(dp->len, dp->blen, dp->word_size, dp->format);
+        st->memInUse = st->memInUse - in->memEstimate + actual;
+        in->memEstimate = actual;
+    }
+
+    init_non_iid_estimates(&in->estimates);
+
+    // The estimator tasks share the data, so its representations are built before they start
+    for (int half = HALF_BITSTRING; half <= HALF_LITERAL; half++) {
+        if (non_iid_estimate_applies(dp, st->initial_entropy, EST_MCV, half) && !build_non_iid_views(dp, half, &in->testRun)) {
+            write_test_run(in);
+            #pragma omp critical(batchOutput)
+            {
+                printf("%s: %s\n", in->file_path.c_str(), in->testRun.errorMsg.c_str());
+                st->failures++;
+            }
+            free_data(dp);
+            retire_input(st, in);
+            return;
+        }
+    }
+
+    for (int i = 0; i < EST_COUNT; i++) {
+        non_iid_estimator est = taskOrder[i];
+
+        for (int half = HALF_BITSTRING; half <= HALF_LITERAL; half++) {
+            if (!non_iid_estimate_applies(dp, st->initial_entropy, est, half)) continue;
+
+            #pragma omp task firstprivate(in, est, half)
+            run_non_iid_estimate(&in->data, est, half, &in->estimates);
+        }
+    }
+
+    #pragma omp taskwait
+
+    assemble_non_iid_test_cases(dp, st->initial_entropy, &in->estimates, in->testRun.testCases);
+    in->testRun.errorLevel = 0;
+    write_test_run(in);
+
+    if (!st->quietMode) {
+        #pragma omp critical(batchOutput)
+        {
+            printf("%s", in->file_path.c_str());
+            if (in->subsetSize != 0) printf(" (block %ld of size %ld)", in->subsetIndex, in->subsetSize);
+            if (st->initial_entropy) {
+                printf(": H_original: %f", in->estimates.H_original);
+                if (dp->alph_size > 2) printf(", H_bitstring: %f, min(H_original, %d X H_bitstring): %f", in->estimates.H_bitstring, dp->word_size, in->estimates.h_assessed);
+            } else {
+                printf(": h': %f", in->estimates.H_bitstring);
+            }
+            if (dp->len < MIN_SIZE) printf(" (*** Warning: data contains less than %d samples ***)", MIN_SIZE);
+            printf("\n");
+        }
+    }
+
+    free_data(dp);
+    retire_input(st, in);
+}
+
+int main(int argc, char* argv[]) {
+    batch_state st;
+    char *manifest_path;
+    int opt;
+    unsigned long long inint;
+    long pages, pageSize;
+
+    st.initial_entropy = true;
+    st.all_bits = true;
+    st.quietMode = false;
+    st.timestamp = getCurrentTimestamp();
+    st.next = 0;
+    st.memInUse = 0;
+    st.failures = 0;
+
+    pages = sysconf(_SC_PHYS_PAGES);
+    pageSize = sysconf(_SC_PAGESIZE);
+    if ((pages > 0) && (pageSize > 0)) st.memLimit = (size_t)pages * pageSize / 4 * 3;
+    else st.memLimit = SIZE_MAX;
+
+    for (int i = 0; i < argc; i++) {
+        std::string Str = std::string(argv[i]);
+        if ("--version" == Str) {
+            printVersion("batch");
+            exit(0);
+        }
+    }
+
+    while ((opt = getopt(argc, argv, "icatqm:")) != -1) {
+        switch (opt) {
+            case 'i':
+                st.initial_entropy = true;
+                break;
+            case 'c':
+                st.initial_entropy = false;
+                break;
+            case 'a':
+                st.all_bits = true;
+                break;
+            case 't':
+                st.all_bits = false;
+                break;
+            case 'q':
+                st.quietMode = true;
+                break;
+            case 'm':
+                inint = strtoull(optarg, NULL, 0);
+                if ((inint == 0) || (inint > (SIZE_MAX >> 20))) {
+                    printf("Invalid memory budget.\n");
+                    print_usage();
+                }
+                st.memLimit = inint << 20;
+                break;
+            default:
+                print_usage();
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 1) {
+        printf("Incorrect usage.\n");
+        print_usage();
+    }
+
+    manifest_path = argv[0];
+
+    ifstream manifest(manifest_path);
+    if (!manifest.is_open()) {
+        printf("Error opening manifest '%s'.\n", manifest_path);
+        print_usage();
+    }
+
+    string text;
+    int lineNumber = 0;
+    while (getline(manifest, text)) {
+        lineNumber++;
+
+        size_t start = text.find_first_not_of(" \t\r");
+        if ((start == string::npos) || (text[start] == '#')) continue;
+
+        batch_input *in = new batch_input;
+        if (!parse_manifest_line(text, lineNumber, in)) {
+            delete in;
+            for (size_t i = 0; i < st.inputs.size(); i++) delete st.inputs[i];
+            exit(-1);
+        }
+        in->memEstimate = estimate_input_memory(&st, in);
+        st.inputs.push_back(in);
+    }
+    manifest.close();
+
+    if (st.inputs.empty()) {
+        printf("The manifest doesn't list any input.\n");
+        exit(-1);
+    }
+
+    if (!st.quietMode) printf("Assessing %zu input(s) using up to %d threads...\n", st.inputs.size(), omp_get_max_threads());
+
+    #pragma omp parallel
+    {
+        #pragma omp single
+        admit_inputs(&st);
+    }
+
+    for (size_t i = 0; i < st.inputs.size(); i++) delete st.inputs[i];
+
+    if (st.failures != 0) {
+        printf("%d input(s) could not be assessed.\n", st.failures);
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Micro-benchmark of the periodicity and covariance kernels (iid/lag_kernels.h).
+// Every kernel built for this machine is checked against the reference periodicity() and covariance() of
+// iid/permutation_tests.h on a range of inputs, then timed on blocks of the size used by the permutation tests.
+// Exits with a non-zero status if any kernel result differs from the reference.
+
+#include "../shared/utils.h"
+#include "../iid/iid_test_run.h"
+#include "../iid/permutation_tests.h"
+
+typedef void (*lag_kernel)(const uint8_t *, const uint8_t *, const long, const bool, const bool, unsigned int *, unsigned long int *);
+
+struct kernel_entry {
+    const char *name;
+    lag_kernel kernel;
+};
+
+void usage() {
+    printf("Usage is: lag_bench [-r <rounds>]\n\n");
+    printf("\t -r: Number of timed rounds over 1000000 samples (default 200).\n");
+    exit(-1);
+}
+
+// Checks one kernel on n samples (n > MAX_LAG); the kernel sees the samples after the first MAX_LAG
+bool check_kernel(const kernel_entry &k, const uint8_t *x, const uint8_t *y, long n, const char *label) {
+    unsigned int per[LAG_COUNT] = {0, 0, 0, 0, 0};
+    unsigned long int cov[LAG_COUNT] = {0, 0, 0, 0, 0};
+    bool ok = true;
+
+    k.kernel(x + MAX_LAG, y + MAX_LAG, n - MAX_LAG, true, true, per, cov);
+
+    for(int l = 0; l < LAG_COUNT; l++) {
+        const unsigned int p = lags[l];
+        // The reference counts the pairs (i, i+p) for i in [0, n-p); these are the pairs that end at MAX_LAG or later
+        unsigned int per_ref = periodicity(x + MAX_LAG - p, p, n - MAX_LAG + p);
+        unsigned long int cov_ref = covariance(y + MAX_LAG - p, p, n - MAX_LAG + p);
+
+        if((per[l] != per_ref) || (cov[l] != cov_ref)) {
+            printf("MISMATCH %s on %s (n = %ld, lag %u): periodicity %u (expected %u), covariance %lu (expected %lu)\n",
+                k.name, label, n, p, per[l], per_ref, cov[l], cov_ref);
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    const long n = 1000000 + MAX_LAG;
+    const long lengths[] = {MAX_LAG + 1, MAX_LAG + 15, MAX_LAG + 63, MAX_LAG + 64, MAX_LAG + 65, 4096 + MAX_LAG, 4096 + 512 + MAX_LAG + 7, n};
+    int rounds = 200;
+    int opt;
+    uint64_t xoshiro256starstarState[4] = {UINT64_C(0x243F6A8885A308D3), UINT64_C(0x13198A2E03707344), UINT64_C(0xA4093822299F31D0), UINT64_C(0x082EFA98EC4E6C89)};
+    vector<kernel_entry> kernels;
+    bool ok = true;
+
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        switch(opt) {
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if(rounds < 1) usage();
+
+    kernel_entry scalar = {"scalar", lag_counts_scalar};
+    kernels.push_back(scalar);
+#if defined(__SSE2__)
+    kernel_entry sse2 = {"sse2", lag_counts_sse2};
+    kernels.push_back(sse2);
+#endif
+#if defined(__AVX2__)
+    kernel_entry avx2 = {"avx2", lag_counts_avx2};
+    kernels.push_back(avx2);
+#endif
+#if defined(__AVX512BW__)
+    kernel_entry avx512 = {"avx512", lag_counts_avx512};
+    kernels.push_back(avx512);
+#endif
+
+    // Inputs: full bytes, the largest products, Conversion I output (0 to 8) and bits
+    const char *labels[] = {"bytes", "all 255", "counts", "bits"};
+    const int maxima[] = {255, 255, 8, 1};
+    vector<vector<uint8_t>> inputs(4, vector<uint8_t>(n));
+    for(int d = 0; d < 4; d++) {
+        for(long i = 0; i < n; i++) inputs[d][i] = (d == 1) ? 255 : (uint8_t)randomRange64(maxima[d], xoshiro256starstarState);
+    }
+    // A second (raw data) sequence for the covariance
+    vector<uint8_t> raw(n);
+    for(long i = 0; i < n; i++) raw[i] = (uint8_t)randomRange64(255, xoshiro256starstarState);
+
+    for(unsigned int k = 0; k < kernels.size(); k++) {
+        for(int d = 0; d < 4; d++) {
+            for(unsigned int j = 0; j < sizeof(lengths) / sizeof(lengths[0]); j++) {
+                ok = check_kernel(kernels[k], inputs[d].data(), inputs[d].data(), lengths[j], labels[d]) && ok;
+                ok = check_kernel(kernels[k], inputs[d].data(), raw.data(), lengths[j], labels[d]) && ok;
+            }
+        }
+    }
+
+    printf("Kernel results %s the reference results\n\n", ok ? "match" : "DO NOT match");
+
+    // Time the kernels on blocks of PERM_BLOCK samples, as in the permutation tests
+    printf("%8s %14s %9s\n", "kernel", "ns / sample", "speedup");
+    double base = 0.0;
+    for(unsigned int k = 0; k < kernels.size(); k++) {
+        unsigned int per[LAG_COUNT] = {0, 0, 0, 0, 0};
+        unsigned long int cov[LAG_COUNT] = {0, 0, 0, 0, 0};
+        const uint8_t *x = inputs[0].data();
+        double start = omp_get_wtime();
+
+        for(int r = 0; r < rounds; r++) {
+            for(long b = MAX_LAG; b < n; b += PERM_BLOCK) {
+                kernels[k].kernel(x + b, x + b, min((long)PERM_BLOCK, n - b), true, true, per, cov);
+            }
+        }
+
+        double elapsed = (omp_get_wtime() - start) * 1e9 / ((double)rounds * (n - MAX_LAG));
+        if(k == 0) base = elapsed;
+        // Print the counts, so that the loops aren't optimized away
+        printf("%8s %14.4f %9.2f   (%u %lu)\n", kernels[k].name, elapsed, base / elapsed, per[0], cov[0]);
+    }
+
+    return ok ? 0 : 1;
+}
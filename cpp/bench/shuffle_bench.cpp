@@ -0,0 +1,101 @@
+// Scaling benchmark for the permutation loop shuffles of permutation_tests (iid/permutation_tests.h).
+// Each thread shuffles its own copy of the data with its own (jumped) RNG lanes, as in permutation_tests,
+// and the time of the whole loop is reported for increasing thread counts, together with the time of the
+// same loop when the shuffles are serialized on a lock (as FYshuffle used to do).
+
+#include "../shared/utils.h"
+#include <mutex>
+
+void usage() {
+    printf("Usage is: shuffle_bench [-n <samples>] [-p <permutations>]\n\n");
+    printf("\t -n: Number of samples shuffled per permutation (default 1000000).\n");
+    printf("\t -p: Number of permutations (default %d).\n", PERMS);
+    exit(-1);
+}
+
+// Time (in seconds) to run the permutation loop with the given number of threads
+double shuffle_loop(const uint8_t *symbols, int sample_size, int permutations, int threads, bool locked, uint64_t *checksum) {
+    static mutex shuffle_mutex;
+    uint64_t mainSeed[4] = {UINT64_C(0x9E3779B97F4A7C15), UINT64_C(0xBF58476D1CE4E5B9), UINT64_C(0x94D049BB133111EB), UINT64_C(0x2545F4914F6CDD1D)};
+    uint64_t sum = 0;
+    double start = omp_get_wtime();
+
+    #pragma omp parallel num_threads(threads) reduction(+:sum)
+    {
+        uint8_t *data = new uint8_t[sample_size];
+        uint8_t *rawdata = new uint8_t[sample_size];
+        xoshiro_lanes lanes;
+
+        memcpy(data, symbols, sample_size);
+        memcpy(rawdata, symbols, sample_size);
+        xoshiro_lanes_seed(&lanes, mainSeed, omp_get_thread_num());
+
+        #pragma omp for
+        for(int i = 0; i < permutations; i++) {
+            if(locked) {
+                unique_lock<mutex> lock(shuffle_mutex);
+                FYshuffle(data, rawdata, sample_size, &lanes);
+            } else {
+                FYshuffle(data, rawdata, sample_size, &lanes);
+            }
+            // Keep the shuffles from being optimized away
+            sum += data[i % sample_size];
+        }
+
+        delete[] data;
+        delete[] rawdata;
+    }
+
+    *checksum = sum;
+    return omp_get_wtime() - start;
+}
+
+int main(int argc, char* argv[]) {
+    int sample_size = 1000000;
+    int permutations = PERMS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:p:")) != -1) {
+        switch(opt) {
+            case 'n':
+                sample_size = atoi(optarg);
+                break;
+            case 'p':
+                permutations = atoi(optarg);
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if((sample_size < 2) || (permutations < 1)) usage();
+
+    uint8_t *symbols = new uint8_t[sample_size];
+    for(int i = 0; i < sample_size; i++) symbols[i] = (uint8_t)(i * 131);
+
+    int max_threads = omp_get_max_threads();
+    vector<int> thread_counts;
+    for(int t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(max_threads);
+
+    printf("%d permutations of %d samples\n\n", permutations, sample_size);
+    printf("%8s %12s %9s %12s %9s\n", "threads", "time (s)", "speedup", "locked (s)", "speedup");
+
+    double base = 0.0, lockedBase = 0.0;
+    for(unsigned int i = 0; i < thread_counts.size(); i++) {
+        uint64_t checksum;
+        int t = thread_counts[i];
+        double elapsed = shuffle_loop(symbols, sample_size, permutations, t, false, &checksum);
+        double lockedElapsed = shuffle_loop(symbols, sample_size, permutations, t, true, &checksum);
+
+        if(i == 0) {
+            base = elapsed;
+            lockedBase = lockedElapsed;
+        }
+
+        printf("%8d %12.3f %9.2f %12.3f %9.2f\n", t, elapsed, base / elapsed, lockedElapsed, lockedBase / lockedElapsed);
+    }
+
+    delete[] symbols;
+    return 0;
+}
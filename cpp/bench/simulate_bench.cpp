@@ -0,0 +1,76 @@
+// Micro-benchmark of the restart sanity check simulation (shared/restart_simulation.h).
+// For a range of H_I, the batched simulateCounts is checked against simulateCount (from the same RNG lanes, the
+// results must be identical), then both are timed over the same number of rounds.
+// Exits with a non-zero status if any result differs from the reference.
+
+#include "../shared/utils.h"
+#include "../shared/restart_simulation.h"
+
+void usage() {
+    printf("Usage is: simulate_bench [-r <rounds>]\n\n");
+    printf("\t -r: Number of timed rounds per H_I (default 200000).\n");
+    exit(-1);
+}
+
+int main(int argc, char* argv[]) {
+    const double entropies[] = {0.1, 0.5, 1.0, 1.7, 2.0, 3.3, 5.0, 7.0, 7.5, 8.0};
+    const int checked = 20000;
+    uint64_t mainSeed[4] = {UINT64_C(0x243F6A8885A308D3), UINT64_C(0x13198A2E03707344), UINT64_C(0xA4093822299F31D0), UINT64_C(0x082EFA98EC4E6C89)};
+    int rounds = 200000;
+    int opt;
+    bool ok = true;
+
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        switch(opt) {
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if(rounds < 1) usage();
+
+    vector<uint16_t> results(max(rounds, checked));
+
+    printf("%6s %14s %14s %9s\n", "H_I", "ref ns/round", "batched", "speedup");
+    for(unsigned int e = 0; e < sizeof(entropies) / sizeof(entropies[0]); e++) {
+        const double p = pow(2.0, -entropies[e]);
+        const int k_effective = ceil(1.0 / p);
+        simulation_map map;
+        xoshiro_lanes lanes;
+        uint64_t checksum = 0;
+
+        init_simulation_map(&map, p);
+
+        // The same lanes give the same rounds
+        xoshiro_lanes_seed(&lanes, mainSeed, e);
+        simulateCounts(&map, &lanes, results.data(), checked);
+        xoshiro_lanes_seed(&lanes, mainSeed, e);
+        for(int r = 0; r < checked; r++) {
+            uint16_t expected = simulateCount(k_effective, p, &lanes);
+            if(results[r] != expected) {
+                printf("MISMATCH for H_I = %g in round %d: %u (expected %u)\n", entropies[e], r, results[r], expected);
+                ok = false;
+                break;
+            }
+        }
+
+        double start = omp_get_wtime();
+        for(int r = 0; r < rounds; r++) checksum += simulateCount(k_effective, p, &lanes);
+        double reference = (omp_get_wtime() - start) * 1e9 / rounds;
+
+        start = omp_get_wtime();
+        simulateCounts(&map, &lanes, results.data(), rounds);
+        double batched = (omp_get_wtime() - start) * 1e9 / rounds;
+        for(int r = 0; r < rounds; r++) checksum -= results[r];
+
+        // Print the checksum (the difference of the sums), so that the loops aren't optimized away
+        printf("%6.2f %14.1f %14.1f %9.2f   (%ld)\n", entropies[e], reference, batched, reference / batched, (long)checksum);
+    }
+
+    printf("\nBatched results %s the reference results\n", ok ? "match" : "DO NOT match");
+
+    return ok ? 0 : 1;
+}
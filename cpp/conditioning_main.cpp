@@ -40,6 +40,7 @@
     printf("\t <h'>: entropy estimate per bit of conditioned sequential dataset (only for '-n' option).\n");
     printf("\t -q: Quiet mode, less output to screen.\n");
     printf("\t -i: Input file name, to run an entropy assessment on a non-vetted conditioned data file and use that value as h'.\n");
+    printf("\t    The file name '-' (or '--stdin') reads the data from standard input.\n");
     printf("\n");
     printf("\t This program computes the entropy of the output of a conditioning function 'h_out' (Section 3.1.5).\n");
     printf("\t If the conditioning function is vetted, then\n\n");
@@ -362,18 +363,26 @@ static long double computeEntropyOfConditionedData(string inputfilename, bool ii
 
     //Have the code establish the symbol width.
     data.word_size = 0;
+    data.format = FORMAT_BYTE;
 
-    //Read in the complete file.
-    if(!read_file_subset(inputfilename.c_str(), &data, 0, 0, testRun)) {
+    //Read in the complete file, recording its hash.
+    char hash[2*SHA256_DIGEST_LENGTH+1];
+    if(!read_file_subset(inputfilename.c_str(), &data, 0, 0, testRun, hash)) {
       fprintf(stderr, "Can't read and trandlate supplied data.\n");
       exit(-1);
     }
+    testRun->sha256 = hash;
+
+    if(!build_views(&data, VIEW_PBSYMBOLS | (iid ? 0 : VIEW_BSYMBOLS), testRun)) {
+      fprintf(stderr, "%s\n", testRun->errorMsg.c_str());
+      exit(-1);
+    }
 
     if (iid) {
         // IID path
         //All of these run the bitstring version of the test (as per SP 800-90B Section 3.1.5.2 Paragraph 2)
         // Section 6.3.1 - Estimate entropy with Most Common Value
-        h_bitstring = min(h_bitstring, most_common(data.bsymbols, data.blen, 2, verbose, "Bitstring"));
+        h_bitstring = min(h_bitstring, most_common(get_pbsymbols(&data), data.blen, verbose, "Bitstring"));
     } else {
         // NON-IID path
         double ret_min_entropy;
@@ -381,25 +390,25 @@ static long double computeEntropyOfConditionedData(string inputfilename, bool ii
 
         //All of these run the bitstring version of the test (as per SP 800-90B Section 3.1.5.2 Paragraph 2)
         // Section 6.3.1 - Estimate entropy with Most Common Value
-        ret_min_entropy = most_common(data.bsymbols, data.blen, 2, verbose, "Bitstring");
+        ret_min_entropy = most_common(get_pbsymbols(&data), data.blen, verbose, "Bitstring");
         h_bitstring = min(ret_min_entropy, h_bitstring);
 
         // Section 6.3.2 - Estimate entropy with Collision Test
-        ret_min_entropy = collision_test(data.bsymbols, data.blen, verbose, "Bitstring");
+        ret_min_entropy = collision_test(get_pbsymbols(&data), data.blen, verbose, "Bitstring");
         h_bitstring = min(ret_min_entropy, h_bitstring);
 
         // Section 6.3.3 - Estimate entropy with Markov Test
-        ret_min_entropy = markov_test(data.bsymbols, data.blen, verbose, "Bitstring");
+        ret_min_entropy = markov_test(get_pbsymbols(&data), data.blen, verbose, "Bitstring");
         h_bitstring = min(ret_min_entropy, h_bitstring);
 
         // Section 6.3.4 - Estimate entropy with Compression Test
-        ret_min_entropy = compression_test(data.bsymbols, data.blen, verbose, "Bitstring");
+        ret_min_entropy = compression_test(get_bsymbols(&data), data.blen, verbose, "Bitstring");
         if (ret_min_entropy >= 0) {
             h_bitstring = min(ret_min_entropy, h_bitstring);
         }
 
         //This call performs both the t-Tuple Test and the LRS Test
-        SAalgs(data.bsymbols, data.blen, 2, bin_t_tuple_res, bin_lrs_res, verbose, "Bitstring");
+        SAalgs(get_bsymbols(&data), data.blen, 2, bin_t_tuple_res, bin_lrs_res, verbose, "Bitstring");
 
         // Section 6.3.5 - Estimate entropy with t-Tuple Test
         if (bin_t_tuple_res >= 0.0) {
@@ -412,25 +421,25 @@ static long double computeEntropyOfConditionedData(string inputfilename, bool ii
         }
 
         // Section 6.3.7 - Estimate entropy with Multi Most Common in Window Test
-        ret_min_entropy = multi_mcw_test(data.bsymbols, data.blen, 2, verbose, "Bitstring");
+        ret_min_entropy = multi_mcw_test(get_bsymbols(&data), data.blen, 2, verbose, "Bitstring");
         if (ret_min_entropy >= 0) {
             h_bitstring = min(ret_min_entropy, h_bitstring);
         }
 
         // Section 6.3.8 - Estimate entropy with Lag Prediction Test
-        ret_min_entropy = lag_test(data.bsymbols, data.blen, 2, verbose, "Bitstring");
+        ret_min_entropy = lag_test(get_bsymbols(&data), data.blen, 2, verbose, "Bitstring");
         if (ret_min_entropy >= 0) {
             h_bitstring = min(ret_min_entropy, h_bitstring);
         }
 
         // Section 6.3.9 - Estimate entropy with Multi Markov Model with Counting Test (MultiMMC)
-        ret_min_entropy = multi_mmc_test(data.bsymbols, data.blen, 2, verbose, "Bitstring");
+        ret_min_entropy = multi_mmc_test(get_bsymbols(&data), data.blen, 2, verbose, "Bitstring");
         if (ret_min_entropy >= 0) {
             h_bitstring = min(ret_min_entropy, h_bitstring);
         }
 
         // Section 6.3.10 - Estimate entropy with LZ78Y Test
-        ret_min_entropy = LZ78Y_test(data.bsymbols, data.blen, 2, verbose, "Bitstring");
+        ret_min_entropy = LZ78Y_test(get_bsymbols(&data), data.blen, 2, verbose, "Bitstring");
         if (ret_min_entropy >= 0) {
             h_bitstring = min(ret_min_entropy, h_bitstring);
         }
@@ -464,8 +473,8 @@ int main(int argc, char* argv[]) {
     string timestamp = getCurrentTimestamp();
     string outputfilename;
     string inputfilename;
-    char *file_path;
     string commandline = recreateCommandLine(argc, argv);
+    translateStdinOption(argc, argv);
     
     for (int i = 0; i < argc; i++) {
         std::string Str = std::string(argv[i]);
@@ -492,7 +501,6 @@ int main(int argc, char* argv[]) {
                 break;
             case 'i':
                 inputfilename = optarg;
-                file_path = optarg;
                 break;
             case 'c':
                 iid = (strcmp(optarg, "iid") == 0);
@@ -515,11 +523,7 @@ int main(int argc, char* argv[]) {
     if(!inputfilename.empty()) {
         testRunNonIid.filename = inputfilename;
     
-        // Record hash of input file
-        char hash[2*SHA256_DIGEST_LENGTH+1];
-
-        sha256_file(file_path, hash);
-        testRunNonIid.sha256 = hash;
+        // The hash of the input file is recorded when it is read (of the decompressed data, if it is compressed)
     }
     
     // Parse args
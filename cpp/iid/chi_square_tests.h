@@ -454,15 +454,14 @@ void goodness_of_fit_calc_observed(const uint8_t data[], const vector<struct tup
 * ---------------------------------------------
 */
 
-void binary_chi_square_independence(const uint8_t data[], double &score, int &df, const int sample_size){
+// data is a packed bitstring (see pack_symbols)
+void binary_chi_square_independence(const uint64_t data[], double &score, int &df, const int sample_size){
 
 	// Compute proportion of 0s and 1s
 	double p0 = 0.0, p1 = 0.0;
 	unsigned int tuple_count;
 
-	for(int i = 0; i < sample_size; i++){
-		p1 += data[i];
-	}
+	p1 = packed_popcount(data, 0, sample_size);
 
 	p1 /= sample_size;
 	p0 = 1.0 - p1;
@@ -497,12 +496,7 @@ void binary_chi_square_independence(const uint8_t data[], double &score, int &df
 
 	for(int i = 0; i < block_count; i++){
 
-		int symbol = 0;
-		for(int j = 0; j < m; j++){
-			symbol = (symbol << 1) | data[i*m + j];
-		}
-
-		occ[symbol]++;
+		occ[packed_bits(data, (long)i*m, m)]++;
 	}
 
 	for(unsigned int i = 0; i < occ.size(); i++){
@@ -557,15 +551,14 @@ void chi_square_independence(const uint8_t data[], double &score, int &df,  cons
 	df = bin_expectations.size() - alphabet_size;
 }
 
-void binary_goodness_of_fit(const uint8_t data[], double &score, int &df, const int sample_size){
+// data is a packed bitstring (see pack_symbols)
+void binary_goodness_of_fit(const uint64_t data[], double &score, int &df, const int sample_size){
 
 	// Find proportion of 1s to the whole data set
 	int sublength = sample_size / 10;
 	int ones = 0;
 
-	for(int i = 0; i < sample_size; i++){
-		ones += data[i];
-	}
+	ones = packed_popcount(data, 0, sample_size);
 
 	double p = divide(ones, sample_size);
 	double T = 0;
@@ -579,9 +572,7 @@ void binary_goodness_of_fit(const uint8_t data[], double &score, int &df, const
 		// Count actual 0s and 1s in each sub-sequence
 		int o0 = 0, o1 = 0;
 
-		for(int j = 0; j < sublength; j++){
-			o1 += data[i*sublength + j];
-		}
+		o1 = packed_popcount(data, (long)i*sublength, sublength);
 
 		o0 = sublength - o1;
 
@@ -638,10 +629,17 @@ bool chi_square_tests(const uint8_t data[], const int sample_size, const int alp
 	double pvalue;
 	int df = 0;
 	bool result = true;
+	vector<uint64_t> bits;
+
+	// The binary tests work on packed bits
+	if(alphabet_size == 2){
+		bits.resize(packed_words(sample_size));
+		pack_symbols(data, sample_size, 1, bits.data());
+	}
 
 	// Chi Square independence test
 	if(alphabet_size == 2){
-		binary_chi_square_independence(data, score, df, sample_size);
+		binary_chi_square_independence(bits.data(), score, df, sample_size);
 	}else{
 		chi_square_independence(data, score, df, sample_size, alphabet_size);
 	}
@@ -671,7 +669,7 @@ bool chi_square_tests(const uint8_t data[], const int sample_size, const int alp
 
 	// Chi Square goodness of fit test
 	if(alphabet_size == 2){
-		binary_goodness_of_fit(data, score, df, sample_size);
+		binary_goodness_of_fit(bits.data(), score, df, sample_size);
 	}else{
 		goodness_of_fit(data, score, df, sample_size, alphabet_size);
 	}
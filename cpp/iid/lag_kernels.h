@@ -0,0 +1,227 @@
+#pragma once
+
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Vector kernels for the 5.1.9 Periodicity and 5.1.10 Covariance tests, which compare each value of a sequence with
+// the values 1, 2, 8, 16 and 32 positions before it. Every lag is evaluated from the same loaded vector of values.
+// The widest kernel allowed by the compiler flags (-march=native) is used; the others are kept so that they can be
+// checked against the scalar kernel (see bench/lag_bench.cpp).
+
+// Number of lags, and the largest one
+#define LAG_COUNT 5
+#define MAX_LAG 32
+
+const unsigned int lags[LAG_COUNT] = {1, 2, 8, 16, 32};
+
+// Each of these adds to per[l] the number of i in [0, len) with x[i-lags[l]] == x[i] (when do_per is set), and
+// to cov[l] the sum of y[i-lags[l]] * y[i] (when do_cov is set). x[-MAX_LAG], ..., x[-1] (and the same for y)
+// must be valid.
+
+void lag_counts_scalar(const uint8_t *x, const uint8_t *y, const long len, const bool do_per, const bool do_cov, unsigned int *per, unsigned long int *cov) {
+	for(int l = 0; l < LAG_COUNT; l++) {
+		const long p = lags[l];
+
+		if(do_per) {
+			unsigned int T = 0;
+			for(long i = 0; i < len; i++) T += (x[i-p] == x[i]);
+			per[l] += T;
+		}
+
+		if(do_cov) {
+			unsigned long int T = 0;
+			for(long i = 0; i < len; i++) T += y[i-p] * y[i];
+			cov[l] += T;
+		}
+	}
+}
+
+// Each multiply-add adds at most 2*255*255 to a 32 bit lane of a covariance accumulator, so the lanes are added up (and
+// reset) every LAG_COV_STEPS steps
+#define LAG_COV_STEPS 16384
+
+#if defined(__SSE2__)
+static inline uint64_t lag_hsum_epu32(__m128i v) {
+	uint32_t lanes[4];
+	_mm_storeu_si128((__m128i *)lanes, v);
+	return (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+void lag_counts_sse2(const uint8_t *x, const uint8_t *y, const long len, const bool do_per, const bool do_cov, unsigned int *per, unsigned long int *cov) {
+	const long vlen = len & ~15L;
+	const __m128i zero = _mm_setzero_si128();
+
+	if(do_per) {
+		unsigned int T[LAG_COUNT] = {0, 0, 0, 0, 0};
+
+		for(long i = 0; i < vlen; i += 16) {
+			const __m128i v = _mm_loadu_si128((const __m128i *)(x + i));
+			for(int l = 0; l < LAG_COUNT; l++) {
+				const __m128i w = _mm_loadu_si128((const __m128i *)(x + i - lags[l]));
+				T[l] += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, w)));
+			}
+		}
+
+		for(int l = 0; l < LAG_COUNT; l++) per[l] += T[l];
+	}
+
+	if(do_cov) {
+		__m128i acc[LAG_COUNT];
+		long steps = 0;
+
+		for(int l = 0; l < LAG_COUNT; l++) acc[l] = zero;
+
+		for(long i = 0; i < vlen; i += 16) {
+			const __m128i v = _mm_loadu_si128((const __m128i *)(y + i));
+			const __m128i vlo = _mm_unpacklo_epi8(v, zero);
+			const __m128i vhi = _mm_unpackhi_epi8(v, zero);
+
+			for(int l = 0; l < LAG_COUNT; l++) {
+				const __m128i w = _mm_loadu_si128((const __m128i *)(y + i - lags[l]));
+				acc[l] = _mm_add_epi32(acc[l], _mm_madd_epi16(vlo, _mm_unpacklo_epi8(w, zero)));
+				acc[l] = _mm_add_epi32(acc[l], _mm_madd_epi16(vhi, _mm_unpackhi_epi8(w, zero)));
+			}
+
+			if(++steps == LAG_COV_STEPS / 2) {
+				for(int l = 0; l < LAG_COUNT; l++) {
+					cov[l] += lag_hsum_epu32(acc[l]);
+					acc[l] = zero;
+				}
+				steps = 0;
+			}
+		}
+
+		for(int l = 0; l < LAG_COUNT; l++) cov[l] += lag_hsum_epu32(acc[l]);
+	}
+
+	lag_counts_scalar(x + vlen, y + vlen, len - vlen, do_per, do_cov, per, cov);
+}
+#endif
+
+#if defined(__AVX2__)
+static inline uint64_t lag_hsum_epu32(__m256i v) {
+	uint32_t lanes[8];
+	uint64_t sum = 0;
+	_mm256_storeu_si256((__m256i *)lanes, v);
+	for(int j = 0; j < 8; j++) sum += lanes[j];
+	return sum;
+}
+
+void lag_counts_avx2(const uint8_t *x, const uint8_t *y, const long len, const bool do_per, const bool do_cov, unsigned int *per, unsigned long int *cov) {
+	const long vlen = len & ~31L;
+	const __m256i zero = _mm256_setzero_si256();
+
+	if(do_per) {
+		unsigned int T[LAG_COUNT] = {0, 0, 0, 0, 0};
+
+		for(long i = 0; i < vlen; i += 32) {
+			const __m256i v = _mm256_loadu_si256((const __m256i *)(x + i));
+			for(int l = 0; l < LAG_COUNT; l++) {
+				const __m256i w = _mm256_loadu_si256((const __m256i *)(x + i - lags[l]));
+				T[l] += __builtin_popcount((unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, w)));
+			}
+		}
+
+		for(int l = 0; l < LAG_COUNT; l++) per[l] += T[l];
+	}
+
+	if(do_cov) {
+		__m256i acc[LAG_COUNT];
+		long steps = 0;
+
+		for(int l = 0; l < LAG_COUNT; l++) acc[l] = zero;
+
+		for(long i = 0; i < vlen; i += 16) {
+			const __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(y + i)));
+
+			for(int l = 0; l < LAG_COUNT; l++) {
+				const __m256i w = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(y + i - lags[l])));
+				acc[l] = _mm256_add_epi32(acc[l], _mm256_madd_epi16(v, w));
+			}
+
+			if(++steps == LAG_COV_STEPS) {
+				for(int l = 0; l < LAG_COUNT; l++) {
+					cov[l] += lag_hsum_epu32(acc[l]);
+					acc[l] = zero;
+				}
+				steps = 0;
+			}
+		}
+
+		for(int l = 0; l < LAG_COUNT; l++) cov[l] += lag_hsum_epu32(acc[l]);
+	}
+
+	lag_counts_scalar(x + vlen, y + vlen, len - vlen, do_per, do_cov, per, cov);
+}
+#endif
+
+#if defined(__AVX512BW__)
+static inline uint64_t lag_hsum_epu32(__m512i v) {
+	uint32_t lanes[16];
+	uint64_t sum = 0;
+	_mm512_storeu_si512((void *)lanes, v);
+	for(int j = 0; j < 16; j++) sum += lanes[j];
+	return sum;
+}
+
+void lag_counts_avx512(const uint8_t *x, const uint8_t *y, const long len, const bool do_per, const bool do_cov, unsigned int *per, unsigned long int *cov) {
+	const long vlen = len & ~63L;
+	const __m512i zero = _mm512_setzero_si512();
+
+	if(do_per) {
+		unsigned int T[LAG_COUNT] = {0, 0, 0, 0, 0};
+
+		for(long i = 0; i < vlen; i += 64) {
+			const __m512i v = _mm512_loadu_si512((const void *)(x + i));
+			for(int l = 0; l < LAG_COUNT; l++) {
+				const __m512i w = _mm512_loadu_si512((const void *)(x + i - lags[l]));
+				T[l] += __builtin_popcountll(_mm512_cmpeq_epi8_mask(v, w));
+			}
+		}
+
+		for(int l = 0; l < LAG_COUNT; l++) per[l] += T[l];
+	}
+
+	if(do_cov) {
+		__m512i acc[LAG_COUNT];
+		long steps = 0;
+
+		for(int l = 0; l < LAG_COUNT; l++) acc[l] = zero;
+
+		for(long i = 0; i < vlen; i += 32) {
+			const __m512i v = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)(y + i)));
+
+			for(int l = 0; l < LAG_COUNT; l++) {
+				const __m512i w = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)(y + i - lags[l])));
+				acc[l] = _mm512_add_epi32(acc[l], _mm512_madd_epi16(v, w));
+			}
+
+			if(++steps == LAG_COV_STEPS) {
+				for(int l = 0; l < LAG_COUNT; l++) {
+					cov[l] += lag_hsum_epu32(acc[l]);
+					acc[l] = zero;
+				}
+				steps = 0;
+			}
+		}
+
+		for(int l = 0; l < LAG_COUNT; l++) cov[l] += lag_hsum_epu32(acc[l]);
+	}
+
+	lag_counts_scalar(x + vlen, y + vlen, len - vlen, do_per, do_cov, per, cov);
+}
+#endif
+
+void lag_counts(const uint8_t *x, const uint8_t *y, const long len, const bool do_per, const bool do_cov, unsigned int *per, unsigned long int *cov) {
+#if defined(__AVX512BW__)
+	lag_counts_avx512(x, y, len, do_per, do_cov, per, cov);
+#elif defined(__AVX2__)
+	lag_counts_avx2(x, y, len, do_per, do_cov, per, cov);
+#elif defined(__SSE2__)
+	lag_counts_sse2(x, y, len, do_per, do_cov, per, cov);
+#else
+	lag_counts_scalar(x, y, len, do_per, do_cov, per, cov);
+#endif
+}
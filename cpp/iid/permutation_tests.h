@@ -4,8 +4,10 @@
 #include <bzlib.h> // sudo apt-get install libbz2-dev
 #include "../shared/utils.h"
 #include "../shared/TestCase.h"
+#include "lag_kernels.h"
 #include <assert.h>
 #include <unistd.h>
+#include <atomic>
 
 // The tests used
 const unsigned int num_tests = 19;
@@ -189,19 +191,21 @@ unsigned int num_increases_decreases(const vector<int> &alt_seq){
 // Helper function to prepare for 5.1.7 and 5.1.8
 vector<unsigned int> find_collisions(const uint8_t data[], const unsigned int n, const unsigned int k){
 	vector<unsigned int> ret;
-	vector<bool> dups(k, false);
+	// Value v is in the current window when dups[v] == window, so that starting a window doesn't clear dups
+	vector<unsigned long int> dups(k, 0);
+	unsigned long int window = 0;
 
 	unsigned long int i=0;
 	unsigned long int j=0;
 
 	// Begin at the start
 	while(i + j < n){
-		for(unsigned int l=0; l<k; l++) dups[l] = false;
+		++window;
 
 		// Progressively increase the number of elements checked
 		while(i + j < n) {
 			// Check for a collision
-			if(dups[data[i+j]]) {
+			if(dups[data[i+j]] == window) {
 				// Record info on collision and end inner loop
 				// Advance outer loop past the collision end
 				// Note that j is not the current window size,
@@ -211,7 +215,7 @@ vector<unsigned int> find_collisions(const uint8_t data[], const unsigned int n,
 				j=0;
 				break;
 			} else {
-				dups[data[i+j]]=true;
+				dups[data[i+j]]=window;
 				++j;
 			}
 
@@ -333,6 +337,346 @@ unsigned int compression(const uint8_t data[], const int sample_size, const uint
 	}
 }
 
+// Number of allocations that bzip2 makes for a compression stream (the stream state and three work arrays), with
+// room to spare
+#define COMPRESSION_ARENA_SLOTS 8
+// Size of the buffer that the compressed data is written to (and discarded from)
+#define COMPRESSION_SINK_SIZE 8192
+// A bzip2 block (block size 5) is full once its run-length encoded data reaches nblockMAX bytes
+#define BZ_BLOCK_MAX (100000*5 - 19)
+// Bits of the stream header ("BZh5"), and of the end of stream marker and combined CRC
+#define BZ_HEADER_BITS 32
+#define BZ_TRAILER_BITS 80
+
+// The memory used by bzip2 for the streams compressed by one thread, kept from one stream to the next
+struct compression_arena {
+	void *slot[COMPRESSION_ARENA_SLOTS];	// by the order in which bzip2 requests it
+	size_t size[COMPRESSION_ARENA_SLOTS];
+	int next;
+	char sink[COMPRESSION_SINK_SIZE];
+};
+
+// Buffers used by the compression statistic, kept from one permutation to the next (one per thread)
+struct compression_ctx {
+	char token[256][4];		// the text of each sample value, with a trailing space (zero padded)
+	uint8_t token_len[256];		// the length of each text
+	char *msg;			// the text of the data
+	size_t msg_size;
+	unsigned int *bounds;		// the parts of the text in each bzip2 block
+	long long int *bits;		// the length of each bzip2 block
+	size_t blocks_size;
+	compression_arena *arenas;	// one per thread of the team, indexed by omp_get_thread_num()
+	bool in_team;			// used by a thread of the team the arenas are for (otherwise, outside of any team)
+};
+
+// The compressed size of a stream, with its first and last bytes
+struct bz_output {
+	unsigned long long int bytes;
+	uint8_t head[16];
+	uint8_t tail[16];
+};
+
+void init_compression_arena(compression_arena *arena) {
+	for(int i = 0; i < COMPRESSION_ARENA_SLOTS; i++) {
+		arena->slot[i] = NULL;
+		arena->size[i] = 0;
+	}
+	arena->next = 0;
+}
+
+void free_compression_arena(compression_arena *arena) {
+	for(int i = 0; i < COMPRESSION_ARENA_SLOTS; i++) {
+		free(arena->slot[i]);
+		arena->slot[i] = NULL;
+		arena->size[i] = 0;
+	}
+}
+
+// arenas are the arenas of the threads that compress with this context (one per thread number); in_team is set
+// if the context is used within the parallel region of those threads, and clear if it's used before that region
+void init_compression_ctx(compression_ctx *ctx, compression_arena *arenas, bool in_team) {
+	for(int i = 0; i < 256; i++) {
+		int res = snprintf(ctx->token[i], sizeof(ctx->token[i]), "%u", i);
+		assert((res >= 1) && (res <= 3));
+		memset(ctx->token[i] + res, 0, sizeof(ctx->token[i]) - res);
+		ctx->token[i][res] = ' ';
+		ctx->token_len[i] = res + 1;
+	}
+
+	ctx->msg = NULL;
+	ctx->msg_size = 0;
+	ctx->bounds = NULL;
+	ctx->bits = NULL;
+	ctx->blocks_size = 0;
+	ctx->arenas = arenas;
+	ctx->in_team = in_team;
+}
+
+void free_compression_ctx(compression_ctx *ctx) {
+	delete[](ctx->msg);
+	delete[](ctx->bounds);
+	delete[](ctx->bits);
+	ctx->msg = NULL;
+	ctx->bounds = NULL;
+	ctx->bits = NULL;
+	ctx->msg_size = 0;
+	ctx->blocks_size = 0;
+}
+
+// bzip2 requests the same sizes in the same order for each stream, so the nth request of a stream is served
+// by the memory of the nth request of the previous stream. The memory is only released with the arena.
+void *compression_alloc(void *opaque, int n, int m) {
+	compression_arena *arena = (compression_arena *)opaque;
+	size_t size = (size_t)n * (size_t)m;
+	int slot = arena->next;
+
+	if(slot >= COMPRESSION_ARENA_SLOTS) return NULL;
+
+	if(arena->size[slot] < size) {
+		free(arena->slot[slot]);
+		arena->slot[slot] = malloc(size);
+		arena->size[slot] = (arena->slot[slot] == NULL) ? 0 : size;
+		if(arena->slot[slot] == NULL) return NULL;
+	}
+
+	arena->next++;
+	return arena->slot[slot];
+}
+
+void compression_free(void *opaque, void *p) {
+	(void)opaque;
+	(void)p;
+}
+
+// Compresses text[0..len) as BZ2_bzBuffToBuffCompress(..., 5, 0, 0) would, without keeping the compressed data
+bool bz_compress(const char *text, unsigned int len, compression_arena *arena, bz_output *out) {
+	bz_stream strm;
+	int rc;
+
+	strm.bzalloc = compression_alloc;
+	strm.bzfree = compression_free;
+	strm.opaque = arena;
+	arena->next = 0;
+
+	if(BZ2_bzCompressInit(&strm, 5, 0, 0) != BZ_OK) return false;
+
+	strm.next_in = (char *)text;
+	strm.avail_in = len;
+	out->bytes = 0;
+
+	do {
+		strm.next_out = arena->sink;
+		strm.avail_out = sizeof(arena->sink);
+		rc = BZ2_bzCompress(&strm, BZ_FINISH);
+
+		// Keep the first and last bytes of the stream
+		size_t produced = sizeof(arena->sink) - strm.avail_out;
+		for(size_t i = 0; (i < produced) && (out->bytes + i < sizeof(out->head)); i++) out->head[out->bytes + i] = arena->sink[i];
+		if(produced >= sizeof(out->tail)) {
+			memcpy(out->tail, arena->sink + produced - sizeof(out->tail), sizeof(out->tail));
+		} else if(produced > 0) {
+			memmove(out->tail, out->tail + produced, sizeof(out->tail) - produced);
+			memcpy(out->tail + sizeof(out->tail) - produced, arena->sink, produced);
+		}
+		out->bytes += produced;
+	} while(rc == BZ_FINISH_OK);
+
+	BZ2_bzCompressEnd(&strm);
+
+	return rc == BZ_STREAM_END;
+}
+
+// Splits the text into the parts that bzip2 puts in each of its blocks, following the run-length encoding (RLE1)
+// and the block size test of bzip2 (a block is full once BZ_BLOCK_MAX run-length encoded bytes are in it). A run
+// that is still open when a block fills up goes to the next block, so each block holds a contiguous part of the
+// text: block k holds text[bounds[k]..bounds[k+1]). Returns the number of blocks.
+size_t bz_block_bounds(const char *text, unsigned int len, compression_ctx *ctx) {
+	unsigned int run_ch = 256;	// the character of the open run (256 for none)
+	unsigned int run_len = 0;
+	unsigned int run_start = 0;	// where the open run starts in the text
+	unsigned long int nblock = 0;
+	size_t blocks = 0;
+
+	// A block holds at least BZ_BLOCK_MAX characters (one byte per character)
+	size_t max_blocks = len / BZ_BLOCK_MAX + 2;
+	if(ctx->blocks_size < max_blocks) {
+		delete[](ctx->bounds);
+		delete[](ctx->bits);
+		ctx->bounds = new unsigned int[max_blocks + 1];
+		ctx->bits = new long long int[max_blocks];
+		ctx->blocks_size = max_blocks;
+	}
+
+	ctx->bounds[blocks] = 0;
+
+	for(unsigned int i = 0; i < len; i++) {
+		const unsigned int ch = (uint8_t)text[i];
+
+		if(nblock >= BZ_BLOCK_MAX) {
+			blocks++;
+			ctx->bounds[blocks] = run_start;
+			nblock = 0;
+		}
+
+		if((ch != run_ch) || (run_len == 255)) {
+			if(run_ch < 256) nblock += (run_len < 4) ? run_len : 5;
+			run_ch = ch;
+			run_len = 1;
+			run_start = i;
+		} else {
+			run_len++;
+		}
+	}
+
+	blocks++;
+	ctx->bounds[blocks] = len;
+
+	return blocks;
+}
+
+// The length in bits of the (only) block of a stream, from the stream's end: the stream ends with the end of stream
+// marker and the combined CRC (here the CRC of the block, found after the stream header and block marker), padded
+// with 0 bits to a whole byte. Returns -1 if the padding can't be determined.
+long long int bz_block_bits(const bz_output *out) {
+	const uint64_t eos = UINT64_C(0x177245385090);
+	uint64_t trailer_hi, trailer_lo;
+	unsigned long long int total = out->bytes * 8;
+	long long int bits = -1;
+
+	if(out->bytes < 14 + 11) return -1;
+
+	// The 80 trailer bits, as a 48 bit and a 32 bit part
+	trailer_hi = eos;
+	trailer_lo = ((uint64_t)out->head[10] << 24) | ((uint64_t)out->head[11] << 16) | ((uint64_t)out->head[12] << 8) | out->head[13];
+
+	for(int pad = 0; pad < 8; pad++) {
+		uint64_t hi = 0, lo = 0, padding = 0;
+		// Bit number j (counted from the end of the trailer) of the last 16 bytes
+		for(int j = 0; j < 80 + pad; j++) {
+			int pos = 8 * (int)sizeof(out->tail) - 1 - j;
+			uint64_t bit = (out->tail[pos / 8] >> (7 - pos % 8)) & 1;
+			if(j < pad) padding |= bit;
+			else if(j < pad + 32) lo |= bit << (j - pad);
+			else hi |= bit << (j - pad - 32);
+		}
+
+		if((padding == 0) && (lo == trailer_lo) && (hi == trailer_hi)) {
+			// More than one padding fits
+			if(bits >= 0) return -1;
+			bits = (long long int)(total - pad) - BZ_HEADER_BITS - BZ_TRAILER_BITS;
+		}
+	}
+
+	return bits;
+}
+
+// Makes sure that the text buffer of ctx holds sample_size samples (up to max_symbol), as compression() above does,
+// with room for copying a whole token at the end
+void compression_reserve(const int sample_size, const uint8_t max_symbol, compression_ctx *ctx) {
+	size_t needed = (size_t)(floor(log10(max_symbol))+2.0)*sample_size + sizeof(ctx->token[0]);
+
+	if(ctx->msg_size < needed) {
+		delete[](ctx->msg);
+		ctx->msg = new char[needed];
+		ctx->msg_size = needed;
+	}
+}
+
+// Compresses the text ctx->msg[0..curlen) and returns the length of the compressed data (0 on failure).
+// The compressed data is only counted, not kept. When the text spans several bzip2 blocks, the blocks are
+// compressed (as separate streams) in parallel by the team of threads, and the length of the stream is put
+// together from the lengths of the blocks.
+unsigned int compress_text(const unsigned int curlen, compression_ctx *ctx) {
+	size_t blocks;
+	bz_output out;
+
+	blocks = bz_block_bounds(ctx->msg, curlen, ctx);
+
+	if(blocks > 1) {
+		long long int total = BZ_HEADER_BITS + BZ_TRAILER_BITS;
+
+		// Tasks only within the team the arenas are for: before its region, the caller may be a thread of some
+		// enclosing team (as in ea_restart), whose thread numbers don't index the arenas; a nested team's do
+		if(ctx->in_team) {
+			// Idle threads of the team (e.g., those done with their permutations) can pick up the blocks
+			for(size_t k = 0; k < blocks; k++) {
+				#pragma omp task firstprivate(k) shared(ctx)
+				{
+					bz_output block_out;
+					compression_arena *arena = &ctx->arenas[omp_get_thread_num()];
+					ctx->bits[k] = bz_compress(ctx->msg + ctx->bounds[k], ctx->bounds[k+1] - ctx->bounds[k], arena, &block_out) ? bz_block_bits(&block_out) : -1;
+				}
+			}
+			#pragma omp taskwait
+		} else {
+			#pragma omp parallel for schedule(dynamic, 1)
+			for(size_t k = 0; k < blocks; k++) {
+				bz_output block_out;
+				compression_arena *arena = &ctx->arenas[omp_get_thread_num()];
+				ctx->bits[k] = bz_compress(ctx->msg + ctx->bounds[k], ctx->bounds[k+1] - ctx->bounds[k], arena, &block_out) ? bz_block_bits(&block_out) : -1;
+			}
+		}
+
+		for(size_t k = 0; (k < blocks) && (total >= 0); k++) total = (ctx->bits[k] < 0) ? -1 : total + ctx->bits[k];
+
+		if(total >= 0) return (unsigned int)((total + 7) / 8);
+		// Otherwise compress the text as one stream
+	}
+
+	// Return with proper return code
+	if(bz_compress(ctx->msg, curlen, &ctx->arenas[ctx->in_team ? omp_get_thread_num() : 0], &out)){
+		return (unsigned int)out.bytes;
+	}else{
+		return 0;
+	}
+}
+
+// 5.1.11 Compression Test, as compression() above, using the buffers of ctx
+unsigned int compression(const uint8_t data[], const int sample_size, const uint8_t max_symbol, compression_ctx *ctx){
+	char *curmsg;
+	unsigned int curlen;
+
+	assert(max_symbol > 0);
+	compression_reserve(sample_size, max_symbol, ctx);
+
+	// Build string of bytes
+	curmsg = ctx->msg;
+	for(int i = 0; i < sample_size; ++i) {
+		memcpy(curmsg, ctx->token[data[i]], sizeof(ctx->token[0]));
+		curmsg += ctx->token_len[data[i]];
+	}
+	curlen = (unsigned int)(curmsg - ctx->msg);
+
+	// Remove the extra ' ' at the end
+	if(curlen > 0) curlen--;
+
+	return compress_text(curlen, ctx);
+}
+
+// 5.1.11 Compression Test of binary data packed in bits (as by pack_bits), where the raw value of a 0 bit is
+// raw[0] and that of a 1 bit is raw[1]
+unsigned int compression_bits(const uint64_t bits[], const int sample_size, const uint8_t raw[2], const uint8_t max_symbol, compression_ctx *ctx){
+	char *curmsg;
+	unsigned int curlen;
+
+	assert(max_symbol > 0);
+	compression_reserve(sample_size, max_symbol, ctx);
+
+	// Build string of bytes
+	curmsg = ctx->msg;
+	for(int i = 0; i < sample_size; ++i) {
+		const uint8_t value = raw[(bits[i >> 6] >> (i & 63)) & 1];
+		memcpy(curmsg, ctx->token[value], sizeof(ctx->token[0]));
+		curmsg += ctx->token_len[value];
+	}
+	curlen = (unsigned int)(curmsg - ctx->msg);
+
+	// Remove the extra ' ' at the end
+	if(curlen > 0) curlen--;
+
+	return compress_text(curlen, ctx);
+}
+
 /*
  * ---------------------------------------------
  * 	  HELPERS FOR PERMUTATION TEST ITERATION
@@ -435,26 +779,417 @@ void covariance_tests(const uint8_t data[], const int alphabet_size, const int s
 	}
 }
 
-void compression_test(const uint8_t data[], const int sample_size, long double *stats, const uint8_t max_symbol, const bool *test_status){
+void compression_test(const uint8_t data[], const int sample_size, long double *stats, const uint8_t max_symbol, const bool *test_status, compression_ctx *ctx){
 
-	if(test_status[18]) stats[18] = compression(data, sample_size, max_symbol);
+	if(test_status[18]) stats[18] = compression(data, sample_size, max_symbol, ctx);
 }
 
-void run_tests(const data_t *dp, const uint8_t data[], const uint8_t rawdata[], const double rawmean, const double median, long double *stats, const bool *test_status){
+/*
+ * ---------------------------------------------
+ * 	  FUSED PERMUTATION TEST KERNEL
+ * ---------------------------------------------
+ */
 
-	// Perform tests
-	excursion_test(rawdata, rawmean, dp->len, stats, test_status);
-	directional_tests(data, dp->alph_size, dp->len, stats, test_status);
-	consecutive_runs_tests(data, median, dp->alph_size, dp->len, stats, test_status);
-	collision_tests(data, dp->alph_size, dp->len, stats, test_status);
-	periodicity_tests(data, dp->alph_size, dp->len, stats, test_status);
-	if(dp->alph_size == 2) {
-		//The two conversions only make sense if the two symbols are 0 and 1.
-		covariance_tests(data, dp->alph_size, dp->len, stats, test_status);
+// The statistics of 5.1.1 through 5.1.10 are computed by one pass over the (permuted) data, a block at a time,
+// so that each sample is read from memory once per permutation. The functions above are the reference
+// implementations of these statistics.
+
+// Number of samples per block (a multiple of 8, so that the conversions of a block are whole bytes)
+#define PERM_BLOCK 4096
+// Runs of a +1/-1 sequence (the sequences of alt_sequence1 and alt_sequence2), one value at a time
+struct perm_runs {
+	unsigned long count;		// number of values
+	unsigned long changes;		// number of values different from the previous one
+	unsigned long pos;		// number of +1 values
+	unsigned int run;		// length of the current run
+	unsigned int max_run;		// length of the longest completed run
+	uint8_t last;			// the previous value is +1
+};
+
+// The values in a collision window: value v is in the window when stamp[v] == generation, so that a new window is
+// started by incrementing generation instead of clearing the table. Each thread keeps one across permutations.
+struct perm_seen {
+	uint32_t stamp[256];
+	uint32_t generation;
+};
+
+// Collisions of a sequence (as found by find_collisions), one value at a time
+struct perm_collisions {
+	perm_seen *seen;		// values in the current window
+	unsigned int window;		// length of the current window
+	unsigned int count;		// number of collisions
+	unsigned int sum;		// total length of the windows ending in a collision
+	unsigned int max;		// longest window ending in a collision
+};
+
+// State of the fused kernel, carried from one block to the next
+struct perm_state {
+	double running_sum;
+	double max_excursion;
+	perm_runs directional;
+	perm_runs median;
+	perm_collisions collisions;
+	unsigned int periodicity[5];
+	unsigned long int covariance[5];
+};
+
+static inline void perm_runs_init(perm_runs *r) {
+	r->count = 0;
+	r->changes = 0;
+	r->pos = 0;
+	r->run = 1;
+	r->max_run = 0;
+	r->last = 0;
+}
+
+// Adds the values up[0], ..., up[len-1] (1 for +1, 0 for -1) to the runs
+static inline void perm_runs_add(perm_runs *r, const uint8_t *up, const long len) {
+	unsigned long changes = 0, pos = 0;
+	unsigned int run = r->run, max_run = r->max_run;
+	uint8_t last = r->last;
+	long i = 0;
+
+	if(len == 0) return;
+
+	// The first value starts the first run
+	if(r->count == 0) {
+		last = up[0];
+		pos = up[0];
+		i = 1;
+	}
+
+	for(; i < len; i++) {
+		const uint8_t same = (up[i] == last);
+		changes += !same;
+		pos += up[i];
+		run = same ? run + 1 : 1;
+		max_run = max(max_run, run);
+		last = up[i];
+	}
+
+	r->changes += changes;
+	r->pos += pos;
+	r->count += len;
+	r->run = run;
+	r->max_run = max_run;
+	r->last = last;
+}
+
+void init_perm_seen(perm_seen *seen) {
+	memset(seen->stamp, 0, sizeof(seen->stamp));
+	seen->generation = 1;
+}
+
+// Starts a new (empty) window
+static inline void perm_seen_next(perm_seen *seen) {
+	if(++seen->generation == 0) init_perm_seen(seen);
+}
+
+static inline void perm_collisions_add(perm_collisions *c, const uint8_t v) {
+	perm_seen *seen = c->seen;
+
+	if(seen->stamp[v] == seen->generation) {
+		c->count++;
+		c->sum += c->window + 1;
+		if(c->window + 1 > c->max) c->max = c->window + 1;
+		perm_seen_next(seen);
+		c->window = 0;
 	} else {
-		covariance_tests(rawdata, dp->alph_size, dp->len, stats, test_status);
+		seen->stamp[v] = seen->generation;
+		c->window++;
+	}
+}
+
+// Adds the values x[0], ..., x[len-1] of a sequence to the directional runs, periodicity and covariance statistics.
+// x[0] is value number first of the sequence; x[-1], ..., x[-MAX_LAG] are the values before it (those that exist).
+// The periodicity is computed on x, the covariance on y (which has the same layout).
+static inline void perm_sequence_block(const uint8_t *x, const uint8_t *y, const long first, const long len, perm_state *st, const bool *test_status) {
+	if(test_status[1] || test_status[2] || test_status[3]) {
+		uint8_t up[PERM_BLOCK];
+		const long start = (first > 0) ? 0 : 1;
+
+		for(long i = start; i < len; i++) up[i] = (x[i-1] <= x[i]);
+		if(len > start) perm_runs_add(&st->directional, up + start, len - start);
 	}
-	compression_test(rawdata, dp->len, stats, dp->maxsymbol, test_status);
+
+	const bool do_per = test_status[8] || test_status[9] || test_status[10] || test_status[11] || test_status[12];
+	const bool do_cov = test_status[13] || test_status[14] || test_status[15] || test_status[16] || test_status[17];
+
+	if(do_per || do_cov) {
+		// The values (at the start of the sequence) that have fewer than MAX_LAG values before them
+		const long head = (first >= MAX_LAG) ? 0 : min(MAX_LAG - first, len);
+
+		for(int l = 0; l < LAG_COUNT; l++) {
+			const long p = lags[l];
+
+			for(long i = max(p - first, 0L); i < head; i++) {
+				st->periodicity[l] += (x[i-p] == x[i]);
+				st->covariance[l] += y[i-p] * y[i];
+			}
+		}
+
+		lag_counts(x + head, y + head, len - head, do_per, do_cov, st->periodicity, st->covariance);
+	}
+}
+
+void perm_state_init(perm_state *st, perm_seen *seen) {
+	st->running_sum = 0.0;
+	st->max_excursion = 0.0;
+	perm_runs_init(&st->directional);
+	perm_runs_init(&st->median);
+	st->collisions.seen = seen;
+	st->collisions.window = 0;
+	st->collisions.count = 0;
+	st->collisions.sum = 0;
+	st->collisions.max = 0;
+	perm_seen_next(seen);
+	for(int l = 0; l < LAG_COUNT; l++) {
+		st->periodicity[l] = 0;
+		st->covariance[l] = 0;
+	}
+}
+
+// Sets the statistics that are still needed from the final state
+void perm_state_results(const perm_state *st, long double *stats, const bool *test_status) {
+	if(test_status[0]) stats[0] = st->max_excursion;
+	if(test_status[1]) stats[1] = st->directional.changes + ((st->directional.count > 0) ? 1 : 0);
+	if(test_status[2]) stats[2] = max(st->directional.run, st->directional.max_run);
+	if(test_status[3]) stats[3] = max(st->directional.pos, st->directional.count - st->directional.pos);
+	if(test_status[4]) stats[4] = st->median.changes + ((st->median.count > 0) ? 1 : 0);
+	if(test_status[5]) stats[5] = max(st->median.run, st->median.max_run);
+	if(test_status[6]) stats[6] = divide(st->collisions.sum, st->collisions.count);
+	if(test_status[7]) stats[7] = st->collisions.max;
+	for(int l = 0; l < LAG_COUNT; l++) {
+		if(test_status[8 + l]) stats[8 + l] = st->periodicity[l];
+		if(test_status[13 + l]) stats[13 + l] = st->covariance[l];
+	}
+}
+
+// Computes the statistics of 5.1.1 through 5.1.10 that are still needed (those with test_status set) in one pass
+void fused_tests(const data_t *dp, const uint8_t data[], const uint8_t rawdata[], const double rawmean, const double median, long double *stats, const bool *test_status, perm_seen *seen){
+	const bool binary = (dp->alph_size == 2);
+	const long n = dp->len;
+	const bool sequence_needed = test_status[1] || test_status[2] || test_status[3] || test_status[8] || test_status[9] || test_status[10] ||
+		test_status[11] || test_status[12] || test_status[13] || test_status[14] || test_status[15] || test_status[16] || test_status[17];
+	const bool collisions_needed = test_status[6] || test_status[7];
+	const bool median_needed = test_status[4] || test_status[5];
+	// The median of binary data is 0.5
+	const int median_ceil = (int)ceil(binary ? 0.5 : median);
+	// The binary conversions of the current block, preceded by the last MAX_LAG values of the previous blocks
+	uint8_t cs1[MAX_LAG + PERM_BLOCK/8];
+	uint8_t cs2[PERM_BLOCK/8];
+	perm_state st;
+
+	perm_state_init(&st, seen);
+
+	for(long b = 0; b < n; b += PERM_BLOCK) {
+		const long len = min((long)PERM_BLOCK, n - b);
+
+		// 5.1.1 on the raw data
+		if(test_status[0]) {
+			double running_sum = st.running_sum, max_excursion = st.max_excursion;
+
+			for(long i = b; i < b + len; i++) {
+				running_sum += rawdata[i];
+				double d_i = fabs(running_sum - ((i+1) * rawmean));
+				max_excursion = (d_i > max_excursion) ? d_i : max_excursion;
+			}
+
+			st.running_sum = running_sum;
+			st.max_excursion = max_excursion;
+		}
+
+		// 5.1.5 and 5.1.6; a (integer) sample is at least the median exactly when it is at least its ceiling
+		if(median_needed) {
+			uint8_t up[PERM_BLOCK];
+
+			for(long i = 0; i < len; i++) up[i] = (data[b + i] >= median_ceil);
+			perm_runs_add(&st.median, up, len);
+		}
+
+		if(!binary) {
+			// 5.1.2 through 5.1.4, 5.1.9 and 5.1.10 on the data (raw data for the covariance), and 5.1.7 and 5.1.8
+			if(sequence_needed) perm_sequence_block(data + b, rawdata + b, b, len, &st, test_status);
+			if(collisions_needed) {
+				for(long i = b; i < b + len; i++) perm_collisions_add(&st.collisions, data[i]);
+			}
+		} else if(sequence_needed || collisions_needed) {
+			// The same tests on the conversions of the bits (Conversion I, and Conversion II for the collisions)
+			const long bytes = (len + 7) / 8;
+
+			for(long j = 0; j < len / 8; j++) {
+				const uint8_t *bits = data + b + 8*j;
+
+				cs1[MAX_LAG + j] = bits[0] + bits[1] + bits[2] + bits[3] + bits[4] + bits[5] + bits[6] + bits[7];
+				cs2[j] = (bits[0] << 7) | (bits[1] << 6) | (bits[2] << 5) | (bits[3] << 4) | (bits[4] << 3) | (bits[5] << 2) | (bits[6] << 1) | bits[7];
+			}
+
+			// A partial last byte
+			if(bytes > len / 8) {
+				const long j = len / 8;
+				uint8_t ones = 0, value = 0;
+
+				for(long k = 8*j; k < len; k++) {
+					ones += data[b + k];
+					value |= data[b + k] << (7 - (k - 8*j));
+				}
+
+				cs1[MAX_LAG + j] = ones;
+				cs2[j] = value;
+			}
+
+			if(sequence_needed) {
+				perm_sequence_block(cs1 + MAX_LAG, cs1 + MAX_LAG, b / 8, bytes, &st, test_status);
+				memmove(cs1, cs1 + bytes, MAX_LAG);
+			}
+			if(collisions_needed) {
+				for(long j = 0; j < bytes; j++) perm_collisions_add(&st.collisions, cs2[j]);
+			}
+		}
+	}
+
+	perm_state_results(&st, stats, test_status);
+}
+
+// Adds the len bits of w (bit i is bit i%64 of w[i/64]) to the runs, as perm_runs_add() does for the values
+// up[i] = bit i. The runs are found from the bits where the value changes.
+static inline void perm_runs_add_bits(perm_runs *r, const uint64_t *w, const long len) {
+	const long words = (len + 63) / 64;
+	// Where the current run starts (counted as r->count is)
+	long run_start = (r->count > 0) ? (long)r->count - r->run : 0;
+	unsigned long changes = 0, pos = 0;
+	unsigned int max_run = r->max_run;
+
+	if(len == 0) return;
+
+	for(long k = 0; k < words; k++) {
+		const long valid = min(64L, len - 64*k);
+		const uint64_t mask = (valid == 64) ? ~UINT64_C(0) : ((UINT64_C(1) << valid) - 1);
+		const uint64_t x = w[k] & mask;
+		uint64_t prev, t;
+
+		// The value before each bit (the first bit of all has no previous value, so it doesn't start a new run)
+		if(k > 0) prev = w[k-1] >> 63;
+		else if(r->count > 0) prev = r->last;
+		else prev = x & 1;
+
+		t = (x ^ ((x << 1) | prev)) & mask;
+		changes += __builtin_popcountll(t);
+		pos += __builtin_popcountll(x);
+
+		while(t != 0) {
+			const long start = (long)r->count + 64*k + __builtin_ctzll(t);
+			max_run = max(max_run, (unsigned int)(start - run_start));
+			run_start = start;
+			t &= t - 1;
+		}
+	}
+
+	r->changes += changes;
+	r->pos += pos;
+	r->count += len;
+	r->run = (unsigned int)((long)r->count - run_start);
+	r->max_run = max_run;
+	r->last = (w[(len - 1) / 64] >> ((len - 1) % 64)) & 1;
+}
+
+// Conversion I of the 8 bytes (of 8 bits each) of a word: the number of ones in each byte
+static inline uint64_t bytes_popcount(uint64_t x) {
+	x = x - ((x >> 1) & UINT64_C(0x5555555555555555));
+	x = (x & UINT64_C(0x3333333333333333)) + ((x >> 2) & UINT64_C(0x3333333333333333));
+	return (x + (x >> 4)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+}
+
+// Conversion II of the 8 bytes of a word: the first bit of each byte becomes its most significant bit
+static inline uint64_t bytes_reverse(uint64_t x) {
+	x = ((x >> 1) & UINT64_C(0x5555555555555555)) | ((x & UINT64_C(0x5555555555555555)) << 1);
+	x = ((x >> 2) & UINT64_C(0x3333333333333333)) | ((x & UINT64_C(0x3333333333333333)) << 2);
+	return ((x >> 4) & UINT64_C(0x0F0F0F0F0F0F0F0F)) | ((x & UINT64_C(0x0F0F0F0F0F0F0F0F)) << 4);
+}
+
+// fused_tests() for binary data packed in bits (as by pack_bits), where the raw value of a 0 bit is raw[0] and
+// that of a 1 bit is raw[1]. This gives the same statistics as fused_tests() on the unpacked data, while reading
+// an eighth of the memory.
+void fused_tests_binary(const data_t *dp, const uint64_t bits[], const uint8_t raw[2], const double rawmean, long double *stats, const bool *test_status, perm_seen *seen){
+	const long n = dp->len;
+	const bool sequence_needed = test_status[1] || test_status[2] || test_status[3] || test_status[8] || test_status[9] || test_status[10] ||
+		test_status[11] || test_status[12] || test_status[13] || test_status[14] || test_status[15] || test_status[16] || test_status[17];
+	const bool collisions_needed = test_status[6] || test_status[7];
+	const bool median_needed = test_status[4] || test_status[5];
+	// The binary conversions of the current block, preceded by the last MAX_LAG values of the previous blocks
+	uint8_t cs1[MAX_LAG + PERM_BLOCK/8];
+	uint8_t cs2[PERM_BLOCK/8];
+	perm_state st;
+
+	perm_state_init(&st, seen);
+
+	for(long b = 0; b < n; b += PERM_BLOCK) {
+		const long len = min((long)PERM_BLOCK, n - b);
+		const uint64_t *w = bits + b / 64;
+
+		// 5.1.1 on the raw data
+		if(test_status[0]) {
+			double running_sum = st.running_sum, max_excursion = st.max_excursion;
+
+			for(long k = 0; 64*k < len; k++) {
+				uint64_t x = w[k];
+
+				for(long i = b + 64*k; i < min(b + 64*(k+1), b + len); i++, x >>= 1) {
+					running_sum += raw[x & 1];
+					double d_i = fabs(running_sum - ((i+1) * rawmean));
+					max_excursion = (d_i > max_excursion) ? d_i : max_excursion;
+				}
+			}
+
+			st.running_sum = running_sum;
+			st.max_excursion = max_excursion;
+		}
+
+		// 5.1.5 and 5.1.6; the median is 0.5, so the runs are those of the bits
+		if(median_needed) perm_runs_add_bits(&st.median, w, len);
+
+		if(sequence_needed || collisions_needed) {
+			// The conversions of the bits (the bits past the end of the data are 0)
+			const long bytes = (len + 7) / 8;
+
+			for(long k = 0; k < (len + 63) / 64; k++) {
+				const long valid = min(64L, len - 64*k);
+				const uint64_t x = (valid == 64) ? w[k] : (w[k] & ((UINT64_C(1) << valid) - 1));
+				const uint64_t ones = bytes_popcount(x);
+				const uint64_t value = bytes_reverse(x);
+
+				for(long j = 0; (j < 8) && (8*k + j < bytes); j++) {
+					cs1[MAX_LAG + 8*k + j] = (uint8_t)(ones >> (8*j));
+					cs2[8*k + j] = (uint8_t)(value >> (8*j));
+				}
+			}
+
+			if(sequence_needed) {
+				perm_sequence_block(cs1 + MAX_LAG, cs1 + MAX_LAG, b / 8, bytes, &st, test_status);
+				memmove(cs1, cs1 + bytes, MAX_LAG);
+			}
+			if(collisions_needed) {
+				for(long j = 0; j < bytes; j++) perm_collisions_add(&st.collisions, cs2[j]);
+			}
+		}
+	}
+
+	perm_state_results(&st, stats, test_status);
+}
+
+void run_tests(const data_t *dp, const uint8_t data[], const uint8_t rawdata[], const double rawmean, const double median, long double *stats, const bool *test_status, compression_ctx *ctx, perm_seen *seen){
+
+	// Perform tests
+	fused_tests(dp, data, rawdata, rawmean, median, stats, test_status, seen);
+	compression_test(rawdata, dp->len, stats, dp->maxsymbol, test_status, ctx);
+}
+
+// run_tests() for binary data packed in bits, where the raw value of a 0 bit is raw[0] and that of a 1 bit is raw[1]
+void run_tests_binary(const data_t *dp, const uint64_t bits[], const uint8_t raw[2], const double rawmean, long double *stats, const bool *test_status, compression_ctx *ctx, perm_seen *seen){
+
+	// Perform tests
+	fused_tests_binary(dp, bits, raw, rawmean, stats, test_status, seen);
+	if(test_status[18]) stats[18] = compression_bits(bits, dp->len, raw, dp->maxsymbol, ctx);
 }
 
 /*
@@ -463,6 +1198,40 @@ void run_tests(const data_t *dp, const uint8_t data[], const uint8_t rawdata[],
  * ---------------------------------------------
  */
 
+// Number of permutations that a thread takes at a time (and then merges into the counters)
+#define PERM_CHUNK 4
+// Bits per counter in a packed set of counters
+#define PERM_COUNT_BITS 21
+
+// The counters C[i][0], C[i][1] and C[i][2] of a statistic, packed in one word (PERM_COUNT_BITS bits each) so
+// that they are updated with one compare-and-swap. Each statistic has its own cache line.
+struct alignas(64) perm_counters {
+	atomic<uint64_t> word;
+};
+
+static inline int perm_count(const uint64_t word, const int k) {
+	return (int)((word >> (PERM_COUNT_BITS * k)) & ((UINT64_C(1) << PERM_COUNT_BITS) - 1));
+}
+
+// The statistic is decided once it is known to pass (5.1: more than 5 permutations at or above, and more than 5 at or below)
+static inline bool perm_decided(const uint64_t word) {
+	return (perm_count(word, 0) + perm_count(word, 1) > 5) && (perm_count(word, 1) + perm_count(word, 2) > 5);
+}
+
+// Counts one outcome of a statistic (0: greater than, 1: equal to, 2: less than the original result), unless the
+// statistic is already decided. Returns true if this outcome decided it.
+bool perm_add_outcome(perm_counters *c, const int outcome) {
+	uint64_t word = c->word.load();
+	uint64_t updated;
+
+	do {
+		if(perm_decided(word)) return false;
+		updated = word + (UINT64_C(1) << (PERM_COUNT_BITS * outcome));
+	} while(!c->word.compare_exchange_weak(word, updated));
+
+	return perm_decided(updated);
+}
+
 void print_results(int C[][3], const int verbose){
 	cout << endl << endl;
 	cout << "                statistic  C[i][0]  C[i][1]  C[i][2]" << endl;
@@ -572,12 +1341,12 @@ void populateTestCase(IidTestCase &tc, int C[][3]){
     tc.testResults.push_back(tr2);
 }
 
-bool permutation_tests(const data_t *dp, const double rawmean, const double median, const int verbose, IidTestCase &tc){
+bool permutation_tests(data_t *dp, const double rawmean, const double median, const int verbose, IidTestCase &tc){
 	uint64_t xoshiro256starstarMainSeed[4];
 	bool istty;
 
 	// Progress
-	size_t completed = 0;
+	atomic<size_t> completed(0);
 
 	// Counters for the pass/fail of each statistic
 	int C[num_tests][3];
@@ -586,6 +1355,13 @@ bool permutation_tests(const data_t *dp, const double rawmean, const double medi
 	long double t[num_tests];
 	bool test_status[num_tests];
 
+	// The counters of the permutation rounds, the statistics that are decided (bit i is set once statistic i has
+	// passed), and the next permutation to run
+	perm_counters counters[num_tests];
+	const uint32_t all_decided = (UINT32_C(1) << num_tests) - 1;
+	atomic<uint32_t> decided(0);
+	atomic<int> next_perm(0);
+
 	istty = (isatty(STDOUT_FILENO)==1);
 
 	// Build map of results
@@ -596,13 +1372,50 @@ bool permutation_tests(const data_t *dp, const double rawmean, const double medi
 
 		t[i] = -1;
 		test_status[i] = true;
+		counters[i].word = 0;
 	}
 
 	// Run initial tests
 	if(verbose == 2) cout << "Beginning initial tests..." << endl;
 	seed(xoshiro256starstarMainSeed);
 
-	run_tests(dp, dp->symbols, dp->rawsymbols, rawmean, median, t, test_status);
+	// The bzip2 memory of each thread, for the compression statistic
+	const int arena_count = omp_get_max_threads();
+	compression_arena *arenas = new compression_arena[arena_count];
+	for(int i = 0; i < arena_count; i++) init_compression_arena(&arenas[i]);
+
+	// Binary data is permuted packed in bits, when each symbol has a single raw value (raw[symbol])
+	const long words = (dp->len + 63) / 64;
+	uint8_t raw[2] = {0, 0};
+	bool packed = (dp->alph_size == 2);
+	uint64_t *packed_symbols = NULL;
+
+	if(packed) {
+		const uint8_t *symbols = get_symbols(dp);
+		bool seen[2] = {false, false};
+
+		for(long i = 0; (i < dp->len) && packed; i++) {
+			const uint8_t symbol = symbols[i] & 1;
+			if(!seen[symbol]) {
+				seen[symbol] = true;
+				raw[symbol] = dp->rawsymbols[i];
+			}
+			packed = (symbols[i] <= 1) && (dp->rawsymbols[i] == raw[symbol]);
+		}
+	}
+
+	compression_ctx initial_ctx;
+	perm_seen initial_seen;
+	init_compression_ctx(&initial_ctx, arenas, false);
+	init_perm_seen(&initial_seen);
+	if(packed) {
+		packed_symbols = new uint64_t[words];
+		pack_bits(get_symbols(dp), dp->len, packed_symbols);
+		run_tests_binary(dp, packed_symbols, raw, rawmean, t, test_status, &initial_ctx, &initial_seen);
+	} else {
+		run_tests(dp, get_symbols(dp), dp->rawsymbols, rawmean, median, t, test_status, &initial_ctx, &initial_seen);
+	}
+	free_compression_ctx(&initial_ctx);
 
 	if(verbose == 2) {
 		cout << endl << "Initial test results" << endl;
@@ -621,60 +1434,86 @@ bool permutation_tests(const data_t *dp, const double rawmean, const double medi
 
 	#pragma omp parallel
 	{
-		uint8_t *data;
-		uint8_t *rawdata;
-		uint64_t xoshiro256starstarSeed[4];
+		uint8_t *data = NULL;
+		uint8_t *rawdata = NULL;
+		uint64_t *bits = NULL;
+		xoshiro_lanes lanes;
 		long double tp[num_tests];
-		int passed_count;
+		bool status[num_tests];
+		bool finished = false;
+		compression_ctx ctx;
+		perm_seen seen;
 
-		data = new uint8_t[dp->len];
-		rawdata = new uint8_t[dp->len];
+		init_compression_ctx(&ctx, arenas, true);
+		init_perm_seen(&seen);
 
 		// Init results
 		for(unsigned int i = 0; i < num_tests; ++i){
 			tp[i] = -1;
 		}
 
-		for(int i = 0; i < dp->len; ++i){
-			data[i] = dp->symbols[i];
-			rawdata[i] = dp->rawsymbols[i];
+		if(packed) {
+			bits = new uint64_t[words];
+			memcpy(bits, packed_symbols, words * sizeof(uint64_t));
+		} else {
+			data = new uint8_t[dp->len];
+			rawdata = new uint8_t[dp->len];
+
+			for(int i = 0; i < dp->len; ++i){
+				data[i] = dp->symbols[i];
+				rawdata[i] = dp->rawsymbols[i];
+			}
 		}
 
-		passed_count = 0;
-		memcpy(xoshiro256starstarSeed, xoshiro256starstarMainSeed, sizeof(xoshiro256starstarMainSeed));
-		//Cause the RNG to jump omp_get_thread_num() * 2^128 calls
-		xoshiro_jump(omp_get_thread_num(), xoshiro256starstarSeed);
+		// Each thread has its own RNG lanes, omp_get_thread_num() * XOSHIRO_LANES jumps after the main seed
+		xoshiro_lanes_seed(&lanes, xoshiro256starstarMainSeed, omp_get_thread_num());
+
+		// Take chunks of permutations until they are all done, or all the statistics are decided
+		while(!finished) {
+			// The outcome of each statistic in each round of the chunk (-1 when it isn't computed)
+			int8_t outcome[PERM_CHUNK][num_tests];
+			int rounds = 0;
+			int first = next_perm.fetch_add(PERM_CHUNK);
+
+			if(first >= PERMS) break;
 
-		#pragma omp for
-		for(int i = 0; i < PERMS; ++i) {
-			if(passed_count < 19) {
+			for(int i = first; (i < first + PERM_CHUNK) && (i < PERMS); ++i) {
 				char statusMessage[1024];
 				size_t statusMessageLength = 0;
+				uint32_t mask = decided.load();
+				int passed_count;
 
-				FYshuffle(data, rawdata, dp->len, xoshiro256starstarSeed);
-				run_tests(dp, data, rawdata, rawmean, median, tp, test_status);
+				if(mask == all_decided) {
+					finished = true;
+					break;
+				}
 
-				// Aggregate results into the counters
-				#pragma omp critical(resultUpdate)
-				{
-					for(unsigned int j = 0; j < num_tests; ++j){
-						if(test_status[j]) {
-							if(tp[j] > t[j]){
-								C[j][0]++;
-							} else if(tp[j] == t[j]){
-								C[j][1]++;
-							} else {
-								C[j][2]++;
-							}
-							if((C[j][0] + C[j][1] > 5) && (C[j][1] + C[j][2] > 5)) {
-								test_status[j] = false;
-							}
-						}
+				// Only compute the statistics that are still undecided
+				for(unsigned int j = 0; j < num_tests; ++j) status[j] = ((mask >> j) & 1) == 0;
+
+				if(packed) {
+					FYshuffle_bits(bits, dp->len, &lanes);
+					run_tests_binary(dp, bits, raw, rawmean, tp, status, &ctx, &seen);
+				} else {
+					FYshuffle(data, rawdata, dp->len, &lanes);
+					run_tests(dp, data, rawdata, rawmean, median, tp, status, &ctx, &seen);
+				}
+
+				for(unsigned int j = 0; j < num_tests; ++j){
+					if(!status[j]) {
+						outcome[rounds][j] = -1;
+					} else if(tp[j] > t[j]){
+						outcome[rounds][j] = 0;
+					} else if(tp[j] == t[j]){
+						outcome[rounds][j] = 1;
+					} else {
+						outcome[rounds][j] = 2;
 					}
-					passed_count = 0;
-					for(unsigned int j=0; j < num_tests; j++) if(!test_status[j]) passed_count++;
-					completed ++;
-				} // end resultUpdate
+				}
+				rounds++;
+
+				passed_count = __builtin_popcount(decided.load());
+				completed++;
 
 				if(verbose == 2) {
 					int res;
@@ -693,7 +1532,7 @@ bool permutation_tests(const data_t *dp, const double rawmean, const double medi
 						statusMessageLength = 0;
 					}
 
-					res = snprintf(statusMessage+statusMessageLength, sizeof(statusMessage)-statusMessageLength, "%6.02f%% of Permutation test rounds, %6.02f%% of Permutation tests", (100.0*((float)completed)/((float)PERMS)), (100.0*((float)passed_count)/19.0));
+					res = snprintf(statusMessage+statusMessageLength, sizeof(statusMessage)-statusMessageLength, "%6.02f%% of Permutation test rounds, %6.02f%% of Permutation tests", (100.0*((float)completed.load())/((float)PERMS)), (100.0*((float)passed_count)/19.0));
 					assert(res>0);
 					statusMessageLength += res;
 					assert(statusMessageLength < sizeof(statusMessage));
@@ -714,17 +1553,32 @@ bool permutation_tests(const data_t *dp, const double rawmean, const double medi
 						fflush(stdout);
 					}
 				}
-			} else {
-				//We don't have a lock for this branch, so make one to update the completed count.
-				#pragma omp atomic
-				completed ++;
 			}
 
+			// Merge the rounds of the chunk into the counters (the outcomes of statistics that other threads
+			// have decided in the meantime are not counted) and publish the newly decided statistics
+			for(int r = 0; r < rounds; ++r) {
+				for(unsigned int j = 0; j < num_tests; ++j){
+					if((outcome[r][j] >= 0) && perm_add_outcome(&counters[j], outcome[r][j])) decided.fetch_or(UINT32_C(1) << j);
+				}
+			}
 		}
         	delete[](data);
         	delete[](rawdata);
+		delete[](bits);
+		free_compression_ctx(&ctx);
 	} //end parallel
 
+	delete[](packed_symbols);
+
+	for(unsigned int i = 0; i < num_tests; ++i){
+		uint64_t word = counters[i].word.load();
+		for(int k = 0; k < 3; ++k) C[i][k] = perm_count(word, k);
+	}
+
+	for(int i = 0; i < arena_count; i++) free_compression_arena(&arenas[i]);
+	delete[](arenas);
+
 	if(verbose > 1) print_results(C, verbose);
         
     populateTestCase(tc, C);
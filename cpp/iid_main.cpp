@@ -18,8 +18,9 @@
 
 
 [[ noreturn ]] void print_usage() {
-    printf("Usage is: ea_iid [-i|-c] [-a|-t] [-v] [-q] [-l <index>,<samples> ] <file_name> [bits_per_symbol]\n\n");
+    printf("Usage is: ea_iid [-i|-c] [-a|-t] [-v] [-q] [-l <index>,<samples> ] [-f <format>] <file_name> [bits_per_symbol]\n\n");
     printf("\t <file_name>: Must be relative path to a binary file with at least 1 million entries (samples).\n");
+    printf("\t\t Use '-' or '--stdin' to read the samples from standard input (e.g., a pipe).\n");
     printf("\t [bits_per_symbol]: Must be between 1-8, inclusive. By default this value is inferred from the data.\n");
     printf("\t [-i|-c]: '-i' for initial entropy estimate, '-c' for conditioned sequential dataset entropy estimate. The initial entropy estimate is the default.\n");
     printf("\t [-a|-t]: '-a' produces the 'H_bitstring' assessment using all read bits, '-t' truncates the bitstring used to produce the `H_bitstring` assessment to %d bits. Test all data by default.\n", MIN_SIZE);
@@ -27,6 +28,9 @@
     printf("\t -v: Optional verbosity flag for more output. Can be used multiple times.\n");
     printf("\t -q: Quiet mode, less output to screen. This will override any verbose flags.\n");
     printf("\t -l <index>,<samples>\tRead the <index> substring of length <samples>.\n");
+    printf("\t -f <format>: Layout of the samples in the file. 'byte' (the default) is one sample per byte, 'msb' and 'lsb'\n");
+    printf("\t are eight 1-bit samples per byte (most / least significant bit first), and 'nibble' is two 4-bit samples\n");
+    printf("\t per byte (high nibble first). With -l, <index> and <samples> count samples, not bytes.\n");
     printf("\n");
     printf("\t Samples are assumed to be packed into 8-bit values, where the least significant 'bits_per_symbol'\n");
     printf("\t bits constitute the symbol.\n");
@@ -70,6 +74,7 @@ int main(int argc, char* argv[]) {
     char *nextOption;
 
     data.word_size = 0;
+    data.format = FORMAT_BYTE;
     initial_entropy = true;
     all_bits = true;
 
@@ -78,6 +83,7 @@ int main(int argc, char* argv[]) {
     string timestamp = getCurrentTimestamp();
     string outputfilename;
     string commandline = recreateCommandLine(argc, argv);
+    translateStdinOption(argc, argv);
 
     IidTestRun testRun;
     testRun.timestamp = timestamp;
@@ -91,7 +97,7 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    while ((opt = getopt(argc, argv, "icatvl:qo:")) != -1) {
+    while ((opt = getopt(argc, argv, "icatvl:qo:f:")) != -1) {
         switch (opt) {
             case 'i':
                 initial_entropy = true;
@@ -150,6 +156,20 @@ int main(int argc, char* argv[]) {
                 jsonOutput = true;
                 outputfilename = optarg;
                 break;
+            case 'f':
+                if (!parse_sample_format(optarg, &data.format)) {
+                    testRun.errorLevel = -1;
+                    testRun.errorMsg = "Unknown input format.";
+
+                    if (jsonOutput) {
+                        ofstream output;
+                        output.open(outputfilename);
+                        output << testRun.GetAsJson();
+                        output.close();
+                    }
+                    print_usage();
+                }
+                break;
             default:
                 print_usage();
         }
@@ -194,19 +214,12 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    // Record hash of input file
+    // Record hash of input file (computed while the file is being read)
     char hash[2*SHA256_DIGEST_LENGTH+1];
-    sha256_file(file_path, hash);
+    bool readSuccess = read_file_subset(file_path, &data, subsetIndex, subsetSize, &testRun, hash);
     testRun.sha256 = hash;
 
-    if (verbose > 1) {
-        if (subsetSize == 0) {
-            printf("Opening file: '%s' (SHA-256 hash %s)\n", file_path, hash);
-        } else {
-            printf("Opening file: '%s' (SHA-256 hash %s), reading block %ld of size %ld\n", file_path, hash, subsetIndex, subsetSize);
-        }
-    }
-    if (!read_file_subset(file_path, &data, subsetIndex, subsetSize, &testRun)) {
+    if (!readSuccess) {
         if (jsonOutput) {
             ofstream output;
             output.open(outputfilename);
@@ -218,6 +231,14 @@ int main(int argc, char* argv[]) {
         print_usage();
     }
 
+    if (verbose > 1) {
+        if (subsetSize == 0) {
+            printf("Opening file: '%s' (SHA-256 hash %s)\n", file_path, hash);
+        } else {
+            printf("Opening file: '%s' (SHA-256 hash %s), reading block %ld of size %ld\n", file_path, hash, subsetIndex, subsetSize);
+        }
+    }
+
     if (verbose > 1) printf("Loaded %ld samples of %d distinct %d-bit-wide symbols\n", data.len, data.alph_size, data.word_size);
 
     if (data.alph_size <= 1) {
@@ -239,6 +260,19 @@ int main(int argc, char* argv[]) {
 
     if (!all_bits && (data.blen > MIN_SIZE)) data.blen = MIN_SIZE;
 
+    if (!build_views(&data, VIEW_SYMBOLS | (((data.alph_size > 2) || !initial_entropy) ? VIEW_PBSYMBOLS : 0), &testRun)) {
+        if (jsonOutput) {
+            ofstream output;
+            output.open(outputfilename);
+            output << testRun.GetAsJson();
+            output.close();
+        }
+
+        printf("%s\n", testRun.errorMsg.c_str());
+        free_data(&data);
+        exit(-1);
+    }
+
     if ((verbose > 1) && ((data.alph_size > 2) || !initial_entropy)) printf("Number of Binary samples: %ld\n", data.blen);
     if (data.len < MIN_SIZE) printf("\n*** Warning: data contains less than %d samples ***\n\n", MIN_SIZE);
     if (verbose > 1) {
@@ -274,12 +308,12 @@ int main(int argc, char* argv[]) {
 
     // Compute the min-entropy of the dataset
     if (initial_entropy) {
-        H_original = most_common(data.symbols, sample_size, alphabet_size, verbose, "Literal");
+        H_original = most_common(get_symbols(&data), sample_size, alphabet_size, verbose, "Literal");
     }
     tc.h_original = H_original;
 
     if (((data.alph_size > 2) || !initial_entropy)) {
-        H_bitstring = most_common(data.bsymbols, data.blen, 2, verbose, "Bitstring");
+        H_bitstring = most_common(get_pbsymbols(&data), data.blen, verbose, "Bitstring");
     }
     tc.h_bitstring = H_bitstring;
 
@@ -313,7 +347,7 @@ int main(int argc, char* argv[]) {
     tc.h_assessed = h_assessed;
 
     // Compute chi square stats
-    bool chi_square_test_pass = chi_square_tests(data.symbols, sample_size, alphabet_size, verbose);
+    bool chi_square_test_pass = chi_square_tests(get_symbols(&data), sample_size, alphabet_size, verbose);
     tc.passed_chi_square_tests = chi_square_test_pass;
 
     if ((verbose == 1) || (verbose == 2)) {
@@ -331,7 +365,7 @@ int main(int argc, char* argv[]) {
     }
 
     // Compute length of the longest repeated substring stats
-    bool len_LRS_test_pass = len_LRS_test(data.symbols, sample_size, alphabet_size, verbose, "Literal");
+    bool len_LRS_test_pass = len_LRS_test(get_symbols(&data), sample_size, alphabet_size, verbose, "Literal");
     tc.passed_longest_repeated_substring_test = len_LRS_test_pass;
 
     if ((verbose == 1) || (verbose == 2)) {
@@ -12,29 +12,12 @@ double col_exp(double p){
 	return (p/(q*q))*(1.0 + 0.5*(1.0/p - 1.0/q))*F(q) - (p/q)*0.5*(1.0/p - 1.0/q);
 }
 
-// Section 6.3.2 - Collision Estimate
-// data is assumed to be binary (e.g., bit string)
-double collision_test(uint8_t* data, long len, const int verbose, const char *label){
-	long v, i;
-	int t_v;
-	double X, s, p;
+// Section 6.3.2 - Collision Estimate, given the number of collisions v, the sum of the
+// wait times i and the sum of the squared wait times s
+static double collision_estimate(const long v, const long i, double s, const int verbose, const char *label){
+	double X, p;
 	double entEst;
 
-	i = 0;
-	v = 0;
-	s = 0.0;
-
-	// compute wait times until collisions
-	while(i < len-1){
-		if(data[i] == data[i+1]) t_v = 2; // 00 or 11
-		else if(i < len-2) t_v = 3; // 101, 011, 100, or 101
-		else break;
-		
-		v++;
-		s += t_v*t_v;
-		i += t_v;
-	}
-
 	// X is mean of t_v's, s is sample stdev, where
 	// s^2 = (sum(t_v^2) - sum(t_v)^2/v) / (v-1)
 	X = i / (double)v;
@@ -79,3 +62,77 @@ double collision_test(uint8_t* data, long len, const int verbose, const char *la
 
 	return entEst;
 }
+
+// Section 6.3.2 - Collision Estimate
+// data is assumed to be binary (e.g., bit string)
+double collision_test(uint8_t* data, long len, const int verbose, const char *label){
+	long v, i;
+	int t_v;
+	double s;
+
+	i = 0;
+	v = 0;
+	s = 0.0;
+
+	// compute wait times until collisions
+	while(i < len-1){
+		if(data[i] == data[i+1]) t_v = 2; // 00 or 11
+		else if(i < len-2) t_v = 3; // 101, 011, 100, or 101
+		else break;
+		
+		v++;
+		s += t_v*t_v;
+		i += t_v;
+	}
+
+	return collision_estimate(v, i, s, verbose, label);
+}
+
+// Section 6.3.2 - Collision Estimate for a packed bitstring (see pack_symbols)
+// Each word is XORed with the word of following bits; a set bit marks a position where the next
+// bit differs (a wait time of 3), and runs of clear bits are skipped two at a time.
+double collision_test(const uint64_t* data, long len, const int verbose, const char *label){
+	long v, i, v3, k, base, end;
+	long pairs = len - 1;
+	uint64_t diff;
+
+	i = 0;
+	v = 0;
+	v3 = 0;
+
+	// compute wait times until collisions
+	for(k = 0; k*64 < pairs; k++){
+		base = k*64;
+		end = min(base + 64, pairs);
+		if(i >= end) continue;
+
+		diff = data[k] << 1;
+		if(base + 64 < len) diff |= data[k+1] >> 63;
+		diff ^= data[k];
+		if(end - base < 64) diff &= ~0ULL << (64 - (end - base));
+
+		while(i < end){
+			int off = (int)(i - base);
+
+			if((diff << off) == 0){
+				// 00 or 11 all the way to the end of this word
+				long steps = (end - i + 1) / 2;
+				v += steps;
+				i += 2*steps;
+			} else if(((diff >> (63 - off)) & 1) == 0){
+				// 00 or 11
+				v++;
+				i += 2;
+			} else if(i < len-2){
+				// 101, 011, 100, or 101
+				v++;
+				v3++;
+				i += 3;
+			} else break;
+		}
+
+		if(i < end) break;
+	}
+
+	return collision_estimate(v, i, 4.0*(v - v3) + 9.0*v3, verbose, label);
+}
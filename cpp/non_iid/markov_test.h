@@ -1,30 +1,12 @@
 #pragma once
 #include "../shared/utils.h"
 
-// Section 6.3.3 - Markov Estimate
-// data is assumed to be binary (e.g., bit string)
-double markov_test(uint8_t* data, long len, const int verbose, const char *label){
-	long i, C_0, C_1, C_00, C_10;
+// Section 6.3.3 - Markov Estimate, given the counts of 0 bits (C_0), 00 transitions (C_00) and
+// 10 transitions (C_10) over S[0] to S[len-2], and the final bit S[len-1]
+static double markov_estimate(long C_0, const long C_00, const long C_10, const int last, const long len, const int verbose, const char *label){
+	long C_1;
 	double H_min, tmp_min_entropy, P_0, P_1, P_00, P_01, P_10, P_11, entEst;
 
-	C_0 = 0;
-	C_00 = 0;
-	C_10 = 0;
-
-	//Less than 2 symbols don't make sense for a Markov model.
-	assert(len > 1);
-
-	// get counts for unconditional and transition probabilities
-	for(i = 0; i < len-1; i++){
-		if(data[i] == 0){
-			C_0++;
-			if(data[i+1] == 0) C_00++;
-		}
-		else if(data[i+1] == 0) C_10++;
-	}
-
-	//C_0 is now  the number of 0 bits from S[0] to S[len-2]
-	
 	C_1 = len - 1 - C_0; //C_1 is the number of 1 bits from S[0] to S[len-2]
 
 	//Note that P_X1 = C_X1 / C_X = (C_X - C_X0)/C_X = 1.0 - C_X0/C_X = 1.0 - P_X0 
@@ -45,7 +27,7 @@ double markov_test(uint8_t* data, long len, const int verbose, const char *label
 	}
 
 	// account for the last symbol
-	if(data[len-1] == 0) C_0++;
+	if(last == 0) C_0++;
 	//C_0 is now  the number of 0 bits from S[0] to S[len-1]
 
 	P_0 = C_0 / (double)len;
@@ -112,3 +94,65 @@ double markov_test(uint8_t* data, long len, const int verbose, const char *label
 
 	return entEst;
 }
+
+// Section 6.3.3 - Markov Estimate
+// data is assumed to be binary (e.g., bit string)
+double markov_test(uint8_t* data, long len, const int verbose, const char *label){
+	long i, C_0, C_00, C_10;
+
+	C_0 = 0;
+	C_00 = 0;
+	C_10 = 0;
+
+	//Less than 2 symbols don't make sense for a Markov model.
+	assert(len > 1);
+
+	// get counts for unconditional and transition probabilities
+	for(i = 0; i < len-1; i++){
+		if(data[i] == 0){
+			C_0++;
+			if(data[i+1] == 0) C_00++;
+		}
+		else if(data[i+1] == 0) C_10++;
+	}
+
+	//C_0 is now  the number of 0 bits from S[0] to S[len-2]
+
+	return markov_estimate(C_0, C_00, C_10, data[len-1], len, verbose, label);
+}
+
+// Section 6.3.3 - Markov Estimate for a packed bitstring (see pack_symbols)
+// Each word is lined up against the word of following bits, so that the transition counts are popcounts.
+double markov_test(const uint64_t* data, long len, const int verbose, const char *label){
+	long k, C_0, C_00, C_10;
+	long pairs = len - 1;
+	long nwords;
+
+	C_0 = 0;
+	C_00 = 0;
+	C_10 = 0;
+
+	//Less than 2 symbols don't make sense for a Markov model.
+	assert(len > 1);
+
+	nwords = packed_words(pairs);
+	for(k = 0; k < nwords; k++){
+		uint64_t cur = data[k];
+		uint64_t next = cur << 1;
+		uint64_t mask = ~0ULL;
+
+		// bring in the first bit of the following word
+		if((k+1)*64 < len) next |= data[k+1] >> 63;
+
+		// only count transitions that start in S[0] to S[len-2]
+		if((k+1)*64 > pairs) mask <<= (k+1)*64 - pairs;
+
+		C_0 += __builtin_popcountll(~cur & mask);
+		C_00 += __builtin_popcountll(~cur & ~next & mask);
+		C_10 += __builtin_popcountll(cur & ~next & mask);
+	}
+
+	//C_0 is now  the number of 0 bits from S[0] to S[len-2]
+
+	return markov_estimate(C_0, C_00, C_10, (int)packed_bits(data, len-1, 1), len, verbose, label);
+}
@@ -0,0 +1,271 @@
+#pragma once
+#include "../shared/utils.h"
+#include "../shared/most_common.h"
+#include "../shared/lrs_test.h"
+#include "non_iid_test_case.h"
+#include "collision_test.h"
+#include "lz78y_test.h"
+#include "multi_mmc_test.h"
+#include "lag_test.h"
+#include "multi_mcw_test.h"
+#include "compression_test.h"
+#include "markov_test.h"
+
+// The non-IID estimators (Section 6.3), in the order of the test cases in the JSON output.
+// EST_TUPLE produces both the t-Tuple (6.3.5) and the LRS (6.3.6) estimates, as SAalgs shares one suffix array.
+enum non_iid_estimator {
+	EST_MCV = 0,
+	EST_COLLISION,
+	EST_MARKOV,
+	EST_COMPRESSION,
+	EST_TUPLE,
+	EST_MULTI_MCW,
+	EST_LAG,
+	EST_MULTI_MMC,
+	EST_LZ78Y,
+	EST_COUNT
+};
+
+// The test cases of the estimators in the JSON output, and the labels of their estimates in the printed output
+static const char *nonIidTestCaseNames[EST_COUNT] = {"Most Common Value", "Collision Test (for bit strings only)", "Markov Test (for bit strings only)",
+	"Compression Test (for bit strings only)", "T-Tuple Test", "Multi Most Common in Window Test", "Lag Prediction Test",
+	"Multi Markov Model with Counting Test (MultiMMC)", "LZ78Y Test"};
+static const char *nonIidEstimateLabels[EST_COUNT] = {"Most Common Value Estimate", "Collision Test Estimate", "Markov Test Estimate",
+	"Compression Test Estimate", "T-Tuple Test Estimate", "Multi Most Common in Window (MultiMCW) Prediction Test Estimate",
+	"Lag Prediction Test Estimate", "Multi Markov Model with Counting (MultiMMC) Prediction Test Estimate", "LZ78Y Prediction Test Estimate"};
+
+// Halves of the assessment: the bitstring (H_bitstring) and the literal symbols (H_original)
+#define HALF_BITSTRING 0
+#define HALF_LITERAL 1
+
+// Results of the estimators for one data set. Estimates that were not produced are -1.
+struct non_iid_estimates {
+	NonIidTestCase mcv[2];		// most common value details, for each half
+	double h[EST_COUNT][2];		// estimate per estimator and half (the t-Tuple estimate for EST_TUPLE)
+	double lrs[2];			// LRS estimate for each half
+
+	double H_original;
+	double H_bitstring;
+	double h_assessed;
+};
+
+void init_non_iid_estimates(non_iid_estimates *res) {
+	for(int i = 0; i < EST_COUNT; i++) res->h[i][HALF_BITSTRING] = res->h[i][HALF_LITERAL] = -1.0;
+	res->lrs[HALF_BITSTRING] = res->lrs[HALF_LITERAL] = -1.0;
+	res->H_original = res->H_bitstring = res->h_assessed = -1.0;
+}
+
+// Is the estimator run on this half of the data? (as in ea_non_iid)
+bool non_iid_estimate_applies(const data_t *dp, bool initial_entropy, non_iid_estimator est, int half) {
+	if(half == HALF_BITSTRING) return (dp->alph_size > 2) || !initial_entropy;
+
+	// The entropic statistic estimates are for bit strings only
+	if((est == EST_COLLISION) || (est == EST_MARKOV) || (est == EST_COMPRESSION)) return initial_entropy && (dp->alph_size == 2);
+
+	return initial_entropy;
+}
+
+// Build the representations of the data used by the estimators on one half of the data. Returns false (with the
+// error in testRun) if they can't be allocated.
+bool build_non_iid_views(data_t *dp, int half, TestRunBase *testRun) {
+	if(half == HALF_BITSTRING) return build_views(dp, VIEW_BSYMBOLS | VIEW_PBSYMBOLS, testRun);
+	else return build_views(dp, VIEW_SYMBOLS, testRun);
+}
+
+// Run one estimator on one half of the data, with the output of the estimator at the given verbosity (none by
+// default). The estimators only read the data, so any number of these may run concurrently on the same data set
+// (as long as they write to different estimates and have no output), once the representations they use have been
+// built with build_non_iid_views().
+void run_non_iid_estimate(data_t *dp, non_iid_estimator est, int half, non_iid_estimates *res, const int verbose = 0) {
+	const bool bitstring = (half == HALF_BITSTRING);
+	const char *label = bitstring ? "Bitstring" : "Literal";
+	uint8_t *S = bitstring ? get_bsymbols(dp) : get_symbols(dp);
+	long L = bitstring ? dp->blen : dp->len;
+	int k = bitstring ? 2 : dp->alph_size;
+	double *h = &res->h[est][half];
+
+	switch(est) {
+		case EST_MCV:
+			if(bitstring) *h = most_common(get_pbsymbols(dp), dp->blen, verbose, label, res->mcv[half]);
+			else *h = most_common(S, dp->len, dp->alph_size, verbose, label, res->mcv[half]);
+			break;
+		case EST_COLLISION:
+			if(bitstring) *h = collision_test(get_pbsymbols(dp), dp->blen, verbose, label);
+			else *h = collision_test(S, L, verbose, label);
+			break;
+		case EST_MARKOV:
+			if(bitstring) *h = markov_test(get_pbsymbols(dp), dp->blen, verbose, label);
+			else *h = markov_test(S, L, verbose, label);
+			break;
+		case EST_COMPRESSION:
+			*h = compression_test(S, L, verbose, label);
+			break;
+		case EST_TUPLE:
+			SAalgs(S, L, k, *h, res->lrs[half], verbose, label);
+			break;
+		case EST_MULTI_MCW:
+			*h = multi_mcw_test(S, L, k, verbose, label);
+			break;
+		case EST_LAG:
+			*h = lag_test(S, L, k, verbose, label);
+			break;
+		case EST_MULTI_MMC:
+			*h = multi_mmc_test(S, L, k, verbose, label);
+			break;
+		case EST_LZ78Y:
+			*h = LZ78Y_test(S, L, k, verbose, label);
+			break;
+		default:
+			break;
+	}
+}
+
+// Print an estimate (at verbose level 2, as ea_non_iid). The estimates of the estimators that don't always
+// produce one are only printed if they succeeded.
+void print_non_iid_estimate(const data_t *dp, const char *label, int half, double h, bool alwaysUsed, bool binary, const int verbose) {
+	if((verbose != 2) || (!alwaysUsed && (h < 0.0))) return;
+
+	if(half == HALF_BITSTRING) printf("\t%s (bit string) = %f / 1 bit(s)\n", label, h);
+	else printf("\t%s = %f / %d bit(s)\n", label, h, binary ? 1 : dp->word_size);
+}
+
+// Run all the applicable estimators, one after the other. Returns false (with the error in testRun) if the
+// representations of the data can't be built.
+// Without output, all the bitstring estimators run first, and the bitstring is dropped once they are done, so
+// that it doesn't take up memory while the literal estimators run. With output (verbose > 0), the estimators
+// run in the order of the sections of SP 800-90B, each on the bitstring and then on the literal data, and
+// their estimates are printed as they are made (as ea_non_iid).
+bool run_non_iid_estimates(data_t *dp, bool initial_entropy, non_iid_estimates *res, TestRunBase *testRun, const int verbose = 0) {
+	init_non_iid_estimates(res);
+
+	if(verbose > 0) {
+		for(int half = HALF_BITSTRING; half <= HALF_LITERAL; half++) {
+			if(non_iid_estimate_applies(dp, initial_entropy, EST_MCV, half) && !build_non_iid_views(dp, half, testRun)) return false;
+		}
+
+		for(int e = 0; e < EST_COUNT; e++) {
+			non_iid_estimator est = (non_iid_estimator)e;
+			// The entropic statistic estimates are for bit strings only
+			bool binary = (est == EST_COLLISION) || (est == EST_MARKOV) || (est == EST_COMPRESSION);
+			bool alwaysUsed = (est == EST_MCV) || (est == EST_COLLISION) || (est == EST_MARKOV);
+
+			if((verbose == 1) || (verbose == 2)) {
+				if(est == EST_MCV) printf("Running Most Common Value Estimate...\n");
+				else if(est == EST_COLLISION) printf("\nRunning Entropic Statistic Estimates (bit strings only)...\n");
+				else if(est == EST_TUPLE) printf("\nRunning Tuple Estimates...\n");
+				else if(est == EST_MULTI_MCW) printf("\nRunning Predictor Estimates...\n");
+			}
+
+			for(int half = HALF_BITSTRING; half <= HALF_LITERAL; half++) {
+				if(!non_iid_estimate_applies(dp, initial_entropy, est, half)) continue;
+				run_non_iid_estimate(dp, est, half, res, verbose);
+				print_non_iid_estimate(dp, nonIidEstimateLabels[est], half, res->h[est][half], alwaysUsed, binary, verbose);
+			}
+
+			if(est == EST_TUPLE) {
+				for(int half = HALF_BITSTRING; half <= HALF_LITERAL; half++) {
+					if(non_iid_estimate_applies(dp, initial_entropy, est, half)) print_non_iid_estimate(dp, "LRS Test Estimate", half, res->lrs[half], false, false, verbose);
+				}
+			}
+
+			// The remaining estimators don't use the packed bitstring
+			if(est == EST_MARKOV) release_pbsymbols(dp);
+		}
+
+		return true;
+	}
+
+	for(int half = HALF_BITSTRING; half <= HALF_LITERAL; half++) {
+		if(non_iid_estimate_applies(dp, initial_entropy, EST_MCV, half) && !build_non_iid_views(dp, half, testRun)) return false;
+
+		for(int e = 0; e < EST_COUNT; e++) {
+			if(non_iid_estimate_applies(dp, initial_entropy, (non_iid_estimator)e, half)) run_non_iid_estimate(dp, (non_iid_estimator)e, half, res);
+		}
+
+		if(half == HALF_BITSTRING) {
+			release_pbsymbols(dp);
+			release_bsymbols(dp);
+		}
+	}
+
+	return true;
+}
+
+// Build the test cases (including the "Overall" one) from the estimates, and compute H_original, H_bitstring
+// and the assessed min-entropy, following the same rules as ea_non_iid
+void assemble_non_iid_test_cases(const data_t *dp, bool initial_entropy, non_iid_estimates *res, vector<NonIidTestCase> &testCases) {
+	const bool bitstring = non_iid_estimate_applies(dp, initial_entropy, EST_MCV, HALF_BITSTRING);
+	const bool literal = non_iid_estimate_applies(dp, initial_entropy, EST_MCV, HALF_LITERAL);
+	double H_original, H_bitstring, h_assessed;
+
+	// The maximum min-entropy is -log2(1/2^word_size) = word_size
+	// The maximum bit string min-entropy is 1.0
+	H_original = dp->word_size;
+	H_bitstring = 1.0;
+
+	for(int e = 0; e < EST_COUNT; e++) {
+		non_iid_estimator est = (non_iid_estimator)e;
+		// The most common value, collision and Markov estimates are always used; the others only when they succeeded
+		bool alwaysUsed = (est == EST_MCV) || (est == EST_COLLISION) || (est == EST_MARKOV);
+		NonIidTestCase tc;
+
+		// The MCV details are those of the literal estimate, when there is one
+		if(est == EST_MCV) tc = literal ? res->mcv[HALF_LITERAL] : res->mcv[HALF_BITSTRING];
+
+		if(non_iid_estimate_applies(dp, initial_entropy, est, HALF_BITSTRING)) {
+			double h = res->h[est][HALF_BITSTRING];
+			if(alwaysUsed || (h >= 0.0)) {
+				if(est == EST_TUPLE) tc.bin_t_tuple_res = h;
+				else tc.h_bitstring = h;
+				H_bitstring = min(h, H_bitstring);
+			}
+		}
+
+		if(non_iid_estimate_applies(dp, initial_entropy, est, HALF_LITERAL)) {
+			double h = res->h[est][HALF_LITERAL];
+			if(alwaysUsed || (h >= 0.0)) {
+				if(est == EST_TUPLE) tc.t_tuple_res = h;
+				else tc.h_original = h;
+				H_original = min(h, H_original);
+			}
+		}
+
+		tc.testCaseNumber = nonIidTestCaseNames[est];
+		testCases.push_back(tc);
+
+		if(est == EST_TUPLE) {
+			NonIidTestCase tcLrs;
+
+			if(bitstring && (res->lrs[HALF_BITSTRING] >= 0.0)) {
+				tcLrs.bin_lrs_res = res->lrs[HALF_BITSTRING];
+				H_bitstring = min(res->lrs[HALF_BITSTRING], H_bitstring);
+			}
+
+			if(literal && (res->lrs[HALF_LITERAL] >= 0.0)) {
+				tcLrs.lrs_res = res->lrs[HALF_LITERAL];
+				H_original = min(res->lrs[HALF_LITERAL], H_original);
+			}
+
+			tcLrs.testCaseNumber = "LRS Test";
+			testCases.push_back(tcLrs);
+		}
+	}
+
+	h_assessed = dp->word_size;
+	if(bitstring) h_assessed = min(h_assessed, H_bitstring * dp->word_size);
+	if(literal) h_assessed = min(h_assessed, H_original);
+
+	NonIidTestCase tcOverall;
+
+	if(bitstring) tcOverall.h_bitstring = H_bitstring;
+	if(literal) tcOverall.h_original = H_original;
+
+	tcOverall.data_word_size = dp->word_size;
+	tcOverall.testCaseNumber = "Overall";
+	tcOverall.h_assessed = h_assessed;
+	testCases.push_back(tcOverall);
+
+	res->H_original = H_original;
+	res->H_bitstring = H_bitstring;
+	res->h_assessed = h_assessed;
+}
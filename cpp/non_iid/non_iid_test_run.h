@@ -10,6 +10,35 @@
 
 using namespace std;
 
+// Result of one block of a block sweep (ea_non_iid --sweep)
+class NonIidBlockResult {
+public:
+    unsigned long index = 0;
+    long samples = 0;
+    int errorLevel = 0;
+    string errorMsg;
+    vector<NonIidTestCase> testCases;
+
+    Json::Value GetAsJson() {
+        Json::Value json;
+        json["index"] = (Json::UInt64)index;
+        json["samples"] = (Json::Int64)samples;
+        json["errorLevel"] = errorLevel;
+
+        if (errorLevel != 0) {
+            json["errorMessage"] = errorMsg;
+        }
+
+        Json::Value testCasesJson;
+        for (int i = 0; i < (int)testCases.size(); i++){
+            testCasesJson[i] = testCases[i].GetAsJson();
+        }
+
+        json["testCases"] = testCasesJson;
+        return json;
+    }
+};
+
 class NonIidTestRun : public TestRunBase {
 public:
     string GetAsJson() {
@@ -23,11 +52,41 @@ public:
 
         json["testCases"] = testCasesJson;
 
+        if (sweepSize != 0) {
+            Json::Value sweepJson;
+            sweepJson["blockSize"] = (Json::UInt64)sweepSize;
+            sweepJson["blockCount"] = (Json::UInt64)blocks.size();
+            sweepJson["assessedBlocks"] = (Json::UInt64)sweepAssessed;
+            if (sweepAssessed > 0) {
+                sweepJson["minAssessed"] = sweepMin;
+                sweepJson["minBlock"] = (Json::UInt64)sweepMinBlock;
+                for (int i = 0; i < (int)sweepPercentiles.size(); i++) {
+                    sweepJson["percentiles"]["p" + to_string(sweepPercentiles[i].first)] = sweepPercentiles[i].second;
+                }
+            }
+
+            Json::Value blocksJson;
+            for (int i = 0; i < (int)blocks.size(); i++){
+                blocksJson[i] = blocks[i].GetAsJson();
+            }
+            sweepJson["blocks"] = blocksJson;
+
+            json["sweep"] = sweepJson;
+        }
+
         Json::StyledWriter styled;
         return styled.write(json);
     }
 
     const bool IID = false;
     vector<NonIidTestCase> testCases;
+
+    // Block sweep results; sweepSize is 0 when no sweep was done
+    unsigned long sweepSize = 0;
+    unsigned long sweepAssessed = 0;
+    double sweepMin = -1.0;
+    unsigned long sweepMinBlock = 0;
+    vector<pair<int, double>> sweepPercentiles;    // (percentile, assessed min-entropy)
+    vector<NonIidBlockResult> blocks;
 };
 #endif /* NONIIDTESTRUN_H */
@@ -12,6 +12,7 @@
 #include "non_iid/multi_mcw_test.h"
 #include "non_iid/compression_test.h"
 #include "non_iid/markov_test.h"
+#include "non_iid/non_iid_estimates.h"
 
 #include <getopt.h>
 #include <limits.h>
@@ -20,8 +21,9 @@
 #include <openssl/sha.h>
 
 [[ noreturn ]] void print_usage() {
-    printf("Usage is: ea_non_iid [-i|-c] [-a|-t] [-v] [-q] [-l <index>,<samples> ] <file_name> [bits_per_symbol]\n\n");
+    printf("Usage is: ea_non_iid [-i|-c] [-a|-t] [-v] [-q] [-l <index>,<samples> | --sweep <samples>] [-f <format>] <file_name> [bits_per_symbol]\n\n");
     printf("\t <file_name>: Must be relative path to a binary file with at least 1 million entries (samples).\n");
+    printf("\t\t Use '-' or '--stdin' to read the samples from standard input (e.g., a pipe).\n");
     printf("\t [bits_per_symbol]: Must be between 1-8, inclusive. By default this value is inferred from the data.\n");
     printf("\t [-i|-c]: '-i' for initial entropy estimate, '-c' for conditioned sequential dataset entropy estimate. The initial entropy estimate is the default.\n");
     printf("\t [-a|-t]: '-a' produces the 'H_bitstring' assessment using all read bits, '-t' truncates the bitstring used to produce the `H_bitstring` assessment to %d bits. Test all data by default.\n", MIN_SIZE);
@@ -29,6 +31,12 @@
     printf("\t -v: Optional verbosity flag for more output. Can be used multiple times.\n");
     printf("\t -q: Quiet mode, less output to screen. This will override any verbose flags.\n");
     printf("\t -l <index>,<samples>\tRead the <index> substring of length <samples>.\n");
+    printf("\t -f <format>: Layout of the samples in the file. 'byte' (the default) is one sample per byte, 'msb' and 'lsb'\n");
+    printf("\t are eight 1-bit samples per byte (most / least significant bit first), and 'nibble' is two 4-bit samples\n");
+    printf("\t per byte (high nibble first). With -l, <index> and <samples> count samples, not bytes.\n");
+    printf("\t --sweep <samples>: Assess every block of <samples> samples of the file (as '-l 0,<samples>', '-l 1,<samples>', ...\n");
+    printf("\t would), reading the file only once. The blocks are assessed in parallel, and the results of all the blocks are\n");
+    printf("\t reported along with the minimum and percentiles of the assessed min-entropy.\n");
     printf("\n");
     printf("\t Samples are assumed to be packed into 8-bit values, where the least significant 'bits_per_symbol'\n");
     printf("\t bits constitute the symbol.\n");
@@ -58,19 +66,133 @@
     exit(-1);
 }
 
+// Percentiles of the assessed min-entropy reported by a block sweep
+static const int sweepPercentiles[] = {5, 25, 50};
+
+// Assess every subsetSize-sample block of the samples (read by read_file_samples) in parallel. The results are
+// reported in block order, whatever order the blocks are assessed in.
+static void sweep_blocks(const data_t *samples, int word_size, unsigned long subsetSize, bool initial_entropy, bool all_bits, int verbose, NonIidTestRun &testRun) {
+    long nblocks = (long)((samples->len + subsetSize - 1) / subsetSize);
+    vector<NonIidBlockResult> &blocks = testRun.blocks;
+    vector<non_iid_estimates> results(nblocks);
+    vector<int> wordSizes(nblocks);
+    vector<double> assessed;
+    unsigned long shortBlocks = 0;
+
+    blocks.resize(nblocks);
+    testRun.sweepSize = subsetSize;
+
+    if (verbose > 1) printf("Assessing %ld blocks of %lu samples...\n", nblocks, subsetSize);
+
+    // Each block is assessed by a single thread; the blocks are distributed dynamically, as their run times vary.
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long b = 0; b < nblocks; b++) {
+        NonIidBlockResult &block = blocks[b];
+        NonIidTestRun blockRun;
+        data_t data;
+
+        block.index = b;
+        data.word_size = word_size;
+
+        if (!read_data_block(samples, &data, b, subsetSize, &blockRun)) {
+            block.errorLevel = blockRun.errorLevel;
+            block.errorMsg = blockRun.errorMsg;
+            free_data(&data);
+            continue;
+        }
+
+        block.samples = data.len;
+        wordSizes[b] = data.word_size;
+
+        if (data.alph_size <= 1) {
+            block.errorLevel = -1;
+            block.errorMsg = "Symbol alphabet consists of 1 symbol. No entropy awarded...";
+            free_data(&data);
+            continue;
+        }
+
+        if (!all_bits && (data.blen > MIN_SIZE)) data.blen = MIN_SIZE;
+
+        if (!run_non_iid_estimates(&data, initial_entropy, &results[b], &blockRun)) {
+            block.errorLevel = blockRun.errorLevel;
+            block.errorMsg = blockRun.errorMsg;
+            free_data(&data);
+            continue;
+        }
+
+        assemble_non_iid_test_cases(&data, initial_entropy, &results[b], block.testCases);
+
+        free_data(&data);
+    }
+
+    for (long b = 0; b < nblocks; b++) {
+        if (blocks[b].errorLevel != 0) {
+            if (verbose > 0) printf("Block %ld: %s\n", b, blocks[b].errorMsg.c_str());
+            continue;
+        }
+
+        if (blocks[b].samples < MIN_SIZE) shortBlocks++;
+
+        if ((testRun.sweepAssessed == 0) || (results[b].h_assessed < testRun.sweepMin)) {
+            testRun.sweepMin = results[b].h_assessed;
+            testRun.sweepMinBlock = b;
+        }
+        testRun.sweepAssessed++;
+        assessed.push_back(results[b].h_assessed);
+
+        if ((verbose == 1) || (verbose == 2)) {
+            printf("Block %ld", b);
+            if (initial_entropy) {
+                printf(": H_original: %f", results[b].H_original);
+                if (results[b].h[EST_MCV][HALF_BITSTRING] >= 0.0) printf(", H_bitstring: %f, min(H_original, %d X H_bitstring): %f", results[b].H_bitstring, wordSizes[b], results[b].h_assessed);
+            } else {
+                printf(": h': %f", results[b].H_bitstring);
+            }
+            printf("\n");
+        } else if (verbose > 2) {
+            printf("Block %ld assessed min entropy: %.17g\n", b, results[b].h_assessed);
+        }
+    }
+
+    if (shortBlocks > 0) printf("\n*** Warning: %lu block(s) contain less than %d samples ***\n", shortBlocks, MIN_SIZE);
+
+    if (assessed.empty()) return;
+
+    // Nearest-rank percentiles
+    sort(assessed.begin(), assessed.end());
+    for (size_t i = 0; i < sizeof(sweepPercentiles) / sizeof(sweepPercentiles[0]); i++) {
+        size_t rank = (sweepPercentiles[i] * assessed.size() + 99) / 100;
+        testRun.sweepPercentiles.push_back(make_pair(sweepPercentiles[i], assessed[(rank > 0) ? rank - 1 : 0]));
+    }
+
+    if (verbose > 0) {
+        printf("\nAssessed %lu of %ld blocks\n", testRun.sweepAssessed, nblocks);
+        printf("Minimum assessed min entropy: %f (block %lu)\n", testRun.sweepMin, testRun.sweepMinBlock);
+        for (size_t i = 0; i < testRun.sweepPercentiles.size(); i++) {
+            printf("%dth percentile: %f\n", testRun.sweepPercentiles[i].first, testRun.sweepPercentiles[i].second);
+        }
+    }
+
+    NonIidTestCase tcOverall;
+
+    tcOverall.data_word_size = wordSizes[testRun.sweepMinBlock];
+    tcOverall.testCaseNumber = "Overall";
+    tcOverall.h_assessed = testRun.sweepMin;
+    testRun.testCases.push_back(tcOverall);
+}
+
 int main(int argc, char* argv[]) {
 
     bool initial_entropy, all_bits;
     int verbose = 1; //verbose 0 is for JSON output, 1 is the normal mode, 2 is the NIST tool verbose mode, and 3 is for extra verbose output
     bool quietMode = false;
     char *file_path;
-    double H_original, H_bitstring, ret_min_entropy;
+    double H_original, H_bitstring, h_assessed;
     data_t data;
     int opt;
-    double bin_t_tuple_res = -1.0, bin_lrs_res = -1.0;
-    double t_tuple_res = -1.0, lrs_res = -1.0;
     unsigned long subsetIndex = ULONG_MAX;
     unsigned long subsetSize = 0;
+    unsigned long sweepSize = 0;
     unsigned long long inint;
     char *nextOption;
 
@@ -78,12 +200,14 @@ int main(int argc, char* argv[]) {
     string timestamp = getCurrentTimestamp();
     string outputfilename;
     string commandline = recreateCommandLine(argc, argv);
+    translateStdinOption(argc, argv);
 
     NonIidTestRun testRun;
     testRun.timestamp = timestamp;
     testRun.commandline = commandline;
 
     data.word_size = 0;
+    data.format = FORMAT_BYTE;
 
     initial_entropy = true;
     all_bits = true;
@@ -96,7 +220,12 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    while ((opt = getopt(argc, argv, "icatvql:o:")) != -1) {
+    static const struct option longOptions[] = {
+        {"sweep", required_argument, NULL, 'w'},
+        {NULL, 0, NULL, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "icatvql:o:f:", longOptions, NULL)) != -1) {
         switch (opt) {
             case 'i':
                 initial_entropy = true;
@@ -153,6 +282,36 @@ int main(int argc, char* argv[]) {
                 jsonOutput = true;
                 outputfilename = optarg;
                 break;
+            case 'w':
+                inint = strtoull(optarg, NULL, 0);
+                if ((inint == 0) || (inint > ULONG_MAX) || (errno == EINVAL)) {
+                    testRun.errorLevel = -1;
+                    testRun.errorMsg = "Error on sweep block size.";
+
+                    if (jsonOutput) {
+                        ofstream output;
+                        output.open(outputfilename);
+                        output << testRun.GetAsJson();
+                        output.close();
+                    }
+                    print_usage();
+                }
+                sweepSize = inint;
+                break;
+            case 'f':
+                if (!parse_sample_format(optarg, &data.format)) {
+                    testRun.errorLevel = -1;
+                    testRun.errorMsg = "Unknown input format.";
+
+                    if (jsonOutput) {
+                        ofstream output;
+                        output.open(outputfilename);
+                        output << testRun.GetAsJson();
+                        output.close();
+                    }
+                    print_usage();
+                }
+                break;
             default:
                 print_usage();
         }
@@ -176,9 +335,7 @@ int main(int argc, char* argv[]) {
     file_path = argv[0];
 
     char hash[2*SHA256_DIGEST_LENGTH+1];
-    sha256_file(file_path, hash);
 
-    testRun.sha256 = hash;
     testRun.filename = file_path;
 
     if (argc == 2) {
@@ -203,12 +360,60 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    if (verbose > 1) {
-        if (subsetSize == 0) printf("Opening file: '%s' (SHA-256 hash %s)\n", file_path, hash);
-        else printf("Opening file: '%s' (SHA-256 hash %s), reading block %ld of size %ld\n", file_path, hash, subsetIndex, subsetSize);
+    if (sweepSize != 0) {
+        if (subsetSize != 0) {
+            testRun.errorLevel = -1;
+            testRun.errorMsg = "The -l and --sweep options can't be combined.";
+
+            if (jsonOutput) {
+                ofstream output;
+                output.open(outputfilename);
+                output << testRun.GetAsJson();
+                output.close();
+            }
+
+            printf("The -l and --sweep options can't be combined.\n");
+            print_usage();
+        }
+
+        // The file is read (and hashed) once; the blocks are translated separately
+        bool readSuccess = read_file_samples(file_path, &data, &testRun, hash);
+        testRun.sha256 = hash;
+
+        if (!readSuccess) {
+            if (jsonOutput) {
+                ofstream output;
+                output.open(outputfilename);
+                output << testRun.GetAsJson();
+                output.close();
+            }
+            printf("Error reading file.\n");
+            print_usage();
+        }
+
+        if (verbose > 1) printf("Opening file: '%s' (SHA-256 hash %s)\n", file_path, hash);
+        if ((verbose == 1) || (verbose == 2)) printf("\nRunning non-IID tests on blocks of %lu samples...\n\n", sweepSize);
+
+        sweep_blocks(&data, data.word_size, sweepSize, initial_entropy, all_bits, verbose, testRun);
+        testRun.errorLevel = (testRun.sweepAssessed > 0) ? 0 : -1;
+        if (testRun.sweepAssessed == 0) testRun.errorMsg = "No block could be assessed.";
+
+        if (jsonOutput) {
+            ofstream output;
+            output.open(outputfilename);
+            output << testRun.GetAsJson();
+            output.close();
+        }
+
+        free_data(&data);
+        return (testRun.sweepAssessed > 0) ? 0 : -1;
     }
 
-    if (!read_file_subset(file_path, &data, subsetIndex, subsetSize, &testRun)) {
+    // The file is hashed while it is being read
+    bool readSuccess = read_file_subset(file_path, &data, subsetIndex, subsetSize, &testRun, hash);
+    testRun.sha256 = hash;
+
+    if (!readSuccess) {
         if (jsonOutput) {
             ofstream output;
             output.open(outputfilename);
@@ -219,6 +424,11 @@ int main(int argc, char* argv[]) {
         print_usage();
     }
 
+    if (verbose > 1) {
+        if (subsetSize == 0) printf("Opening file: '%s' (SHA-256 hash %s)\n", file_path, hash);
+        else printf("Opening file: '%s' (SHA-256 hash %s), reading block %ld of size %ld\n", file_path, hash, subsetIndex, subsetSize);
+    }
+
     if (verbose > 1) printf("Loaded %ld samples of %d distinct %d-bit-wide symbols\n", data.len, data.alph_size, data.word_size);
 
     if (data.alph_size <= 1) {
@@ -247,254 +457,28 @@ int main(int argc, char* argv[]) {
         if (data.alph_size < (1 << data.word_size)) printf("\nSymbols have been translated.\n");
     }
 
-    // The maximum min-entropy is -log2(1/2^word_size) = word_size
-    // The maximum bit string min-entropy is 1.0
-    H_original = data.word_size;
-    H_bitstring = 1.0;
-
-    if ((verbose == 1) || (verbose == 2)) {
-        printf("\nRunning non-IID tests...\n\n");
-        printf("Running Most Common Value Estimate...\n");
-    }
-
-    // Section 6.3.1 - Estimate entropy with Most Common Value
-    NonIidTestCase tc631;
-
-    if (((data.alph_size > 2) || !initial_entropy)) {
-        ret_min_entropy = most_common(data.bsymbols, data.blen, 2, verbose, "Bitstring", tc631);
-        if (verbose == 2) printf("\tMost Common Value Estimate (bit string) = %f / 1 bit(s)\n", ret_min_entropy);
-        tc631.h_bitstring = ret_min_entropy;
-        H_bitstring = min(ret_min_entropy, H_bitstring);
-    }
-
-    if (initial_entropy) {
-        ret_min_entropy = most_common(data.symbols, data.len, data.alph_size, verbose, "Literal", tc631);
-        if (verbose == 2) printf("\tMost Common Value Estimate = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-        tc631.h_original = ret_min_entropy;
-        H_original = min(ret_min_entropy, H_original);
-    }
-
-    tc631.testCaseNumber = "Most Common Value";
-    testRun.testCases.push_back(tc631);
-
-    // Section 6.3.2 - Estimate entropy with Collision Test (for bit strings only)
-    NonIidTestCase tc632;
-
-    if ((verbose == 1) || (verbose == 2)) printf("\nRunning Entropic Statistic Estimates (bit strings only)...\n");
-
-    if (((data.alph_size > 2) || !initial_entropy)) {
-        ret_min_entropy = collision_test(data.bsymbols, data.blen, verbose, "Bitstring");
-        if (verbose == 2) printf("\tCollision Test Estimate (bit string) = %f / 1 bit(s)\n", ret_min_entropy);
-        tc632.h_bitstring = ret_min_entropy;
-        H_bitstring = min(ret_min_entropy, H_bitstring);
-    }
-
-    if (initial_entropy && (data.alph_size == 2)) {
-        ret_min_entropy = collision_test(data.symbols, data.len, verbose, "Literal");
-        if (verbose == 2) printf("\tCollision Test Estimate = %f / 1 bit(s)\n", ret_min_entropy);
-        tc632.h_original = ret_min_entropy;
-        H_original = min(ret_min_entropy, H_original);
-    }
-
-    tc632.testCaseNumber = "Collision Test (for bit strings only)";
-    testRun.testCases.push_back(tc632);
-
-    // Section 6.3.3 - Estimate entropy with Markov Test (for bit strings only)
-    NonIidTestCase tc633;
-
-    if (((data.alph_size > 2) || !initial_entropy)) {
-        ret_min_entropy = markov_test(data.bsymbols, data.blen, verbose, "Bitstring");
-        if (verbose == 2) printf("\tMarkov Test Estimate (bit string) = %f / 1 bit(s)\n", ret_min_entropy);
-        tc633.h_bitstring = ret_min_entropy;
-        H_bitstring = min(ret_min_entropy, H_bitstring);
-    }
-
-    if (initial_entropy && (data.alph_size == 2)) {
-        ret_min_entropy = markov_test(data.symbols, data.len, verbose, "Literal");
-        if (verbose == 2) printf("\tMarkov Test Estimate = %f / 1 bit(s)\n", ret_min_entropy);
-        tc633.h_original = ret_min_entropy;
-        H_original = min(ret_min_entropy, H_original);
-    }
-
-    tc633.testCaseNumber = "Markov Test (for bit strings only)";
-    testRun.testCases.push_back(tc633);
-
-    // Section 6.3.4 - Estimate entropy with Compression Test (for bit strings only)
-    NonIidTestCase tc634;
-
-    if (((data.alph_size > 2) || !initial_entropy)) {
-        ret_min_entropy = compression_test(data.bsymbols, data.blen, verbose, "Bitstring");
-        if (ret_min_entropy >= 0) {
-            if (verbose == 2) printf("\tCompression Test Estimate (bit string) = %f / 1 bit(s)\n", ret_min_entropy);
-            tc634.h_bitstring = ret_min_entropy;
-            H_bitstring = min(ret_min_entropy, H_bitstring);
-        }
-    }
-
-    if (initial_entropy && (data.alph_size == 2)) {
-        ret_min_entropy = compression_test(data.symbols, data.len, verbose, "Literal");
-        if (ret_min_entropy >= 0) {
-            if (verbose == 2) printf("\tCompression Test Estimate = %f / 1 bit(s)\n", ret_min_entropy);
-            tc634.h_original = ret_min_entropy;
-            H_original = min(ret_min_entropy, H_original);
-        }
-    }
-
-    tc634.testCaseNumber = "Compression Test (for bit strings only)";
-    testRun.testCases.push_back(tc634);
-
-    // Section 6.3.5 - Estimate entropy with t-Tuple Test
-    NonIidTestCase tc635;
-
-    if ((verbose == 1) || (verbose == 2)) printf("\nRunning Tuple Estimates...\n");
-
-    if (((data.alph_size > 2) || !initial_entropy)) {
-        SAalgs(data.bsymbols, data.blen, 2, bin_t_tuple_res, bin_lrs_res, verbose, "Bitstring");
-        if (bin_t_tuple_res >= 0.0) {
-            if (verbose == 2) printf("\tT-Tuple Test Estimate (bit string) = %f / 1 bit(s)\n", bin_t_tuple_res);
-            tc635.bin_t_tuple_res = bin_t_tuple_res;
-            H_bitstring = min(bin_t_tuple_res, H_bitstring);
-        }
-    }
-
-    if (initial_entropy) {
-        SAalgs(data.symbols, data.len, data.alph_size, t_tuple_res, lrs_res, verbose, "Literal");
-        if (t_tuple_res >= 0.0) {
-            if (verbose == 2) printf("\tT-Tuple Test Estimate = %f / %d bit(s)\n", t_tuple_res, data.word_size);
-            tc635.t_tuple_res = t_tuple_res;
-            H_original = min(t_tuple_res, H_original);
-        }
-    }
-
-    tc635.testCaseNumber = "T-Tuple Test";
-    testRun.testCases.push_back(tc635);
-
-    // Section 6.3.6 - Estimate entropy with LRS Test
-    NonIidTestCase tc636;
-
-    if ((((data.alph_size > 2) || !initial_entropy)) && (bin_lrs_res >= 0.0)) {
-        if (verbose == 2) printf("\tLRS Test Estimate (bit string) = %f / 1 bit(s)\n", bin_lrs_res);
-        tc636.bin_lrs_res = bin_lrs_res;
-        H_bitstring = min(bin_lrs_res, H_bitstring);
-    }
-
-    if (initial_entropy && (lrs_res >= 0.0)) {
-        if (verbose == 2) printf("\tLRS Test Estimate = %f / %d bit(s)\n", lrs_res, data.word_size);
-        tc636.lrs_res = lrs_res;
-        H_original = min(lrs_res, H_original);
-    }
-
-    tc636.testCaseNumber = "LRS Test";
-    testRun.testCases.push_back(tc636);
+    if ((verbose == 1) || (verbose == 2)) printf("\nRunning non-IID tests...\n\n");
 
-    // Section 6.3.7 - Estimate entropy with Multi Most Common in Window Test
-    NonIidTestCase tc637;
+    // The estimates are printed (with verbose) as they are made
+    non_iid_estimates estimates;
 
-    if ((verbose == 1) || (verbose == 2)) printf("\nRunning Predictor Estimates...\n");
-
-    if (((data.alph_size > 2) || !initial_entropy)) {
-        ret_min_entropy = multi_mcw_test(data.bsymbols, data.blen, 2, verbose, "Bitstring");
-        if (ret_min_entropy >= 0) {
-            if (verbose == 2) printf("\tMulti Most Common in Window (MultiMCW) Prediction Test Estimate (bit string) = %f / 1 bit(s)\n", ret_min_entropy);
-            tc637.h_bitstring = ret_min_entropy;
-            H_bitstring = min(ret_min_entropy, H_bitstring);
-        }
-    }
-
-    if (initial_entropy) {
-        ret_min_entropy = multi_mcw_test(data.symbols, data.len, data.alph_size, verbose, "Literal");
-        if (ret_min_entropy >= 0) {
-            if (verbose == 2) printf("\tMulti Most Common in Window (MultiMCW) Prediction Test Estimate = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-            tc637.h_original = ret_min_entropy;
-            H_original = min(ret_min_entropy, H_original);
-        }
-    }
-
-    tc637.testCaseNumber = "Multi Most Common in Window Test";
-    testRun.testCases.push_back(tc637);
-
-    // Section 6.3.8 - Estimate entropy with Lag Prediction Test
-    NonIidTestCase tc638;
-
-    if (((data.alph_size > 2) || !initial_entropy)) {
-        ret_min_entropy = lag_test(data.bsymbols, data.blen, 2, verbose, "Bitstring");
-        if (ret_min_entropy >= 0) {
-            if (verbose == 2) printf("\tLag Prediction Test Estimate (bit string) = %f / 1 bit(s)\n", ret_min_entropy);
-            tc638.h_bitstring = ret_min_entropy;
-            H_bitstring = min(ret_min_entropy, H_bitstring);
-        }
-    }
-
-    if (initial_entropy) {
-        ret_min_entropy = lag_test(data.symbols, data.len, data.alph_size, verbose, "Literal");
-        if (ret_min_entropy >= 0) {
-            if (verbose == 2) printf("\tLag Prediction Test Estimate = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-            tc638.h_original = ret_min_entropy;
-            H_original = min(ret_min_entropy, H_original);
-        }
-    }
-
-    tc638.testCaseNumber = "Lag Prediction Test";
-    testRun.testCases.push_back(tc638);
-
-    // Section 6.3.9 - Estimate entropy with Multi Markov Model with Counting Test (MultiMMC)
-    NonIidTestCase tc639;
-
-    if (((data.alph_size > 2) || !initial_entropy)) {
-        ret_min_entropy = multi_mmc_test(data.bsymbols, data.blen, 2, verbose, "Bitstring");
-        if (ret_min_entropy >= 0) {
-            if (verbose == 2) printf("\tMulti Markov Model with Counting (MultiMMC) Prediction Test Estimate (bit string) = %f / 1 bit(s)\n", ret_min_entropy);
-            tc639.h_bitstring = ret_min_entropy;
-            H_bitstring = min(ret_min_entropy, H_bitstring);
-        }
-    }
-
-    if (initial_entropy) {
-        ret_min_entropy = multi_mmc_test(data.symbols, data.len, data.alph_size, verbose, "Literal");
-        if (ret_min_entropy >= 0) {
-            if (verbose == 2) printf("\tMulti Markov Model with Counting (MultiMMC) Prediction Test Estimate = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-            tc639.h_original = ret_min_entropy;
-            H_original = min(ret_min_entropy, H_original);
-        }
-    }
-
-    tc639.testCaseNumber = "Multi Markov Model with Counting Test (MultiMMC)";
-    testRun.testCases.push_back(tc639);
-
-    // Section 6.3.10 - Estimate entropy with LZ78Y Test
-    NonIidTestCase tc6310;
-
-    if (((data.alph_size > 2) || !initial_entropy)) {
-        ret_min_entropy = LZ78Y_test(data.bsymbols, data.blen, 2, verbose, "Bitstring");
-        if (ret_min_entropy >= 0) {
-            if (verbose == 2) printf("\tLZ78Y Prediction Test Estimate (bit string) = %f / 1 bit(s)\n", ret_min_entropy);
-            tc6310.h_bitstring = ret_min_entropy;
-            H_bitstring = min(ret_min_entropy, H_bitstring);
-        }
-    }
-
-    if (initial_entropy) {
-        ret_min_entropy = LZ78Y_test(data.symbols, data.len, data.alph_size, verbose, "Literal");
-        if (ret_min_entropy >= 0) {
-            if (verbose == 2) printf("\tLZ78Y Prediction Test Estimate = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-            tc6310.h_original = ret_min_entropy;
-            H_original = min(ret_min_entropy, H_original);
+    if (!run_non_iid_estimates(&data, initial_entropy, &estimates, &testRun, verbose)) {
+        if (jsonOutput) {
+            ofstream output;
+            output.open(outputfilename);
+            output << testRun.GetAsJson();
+            output.close();
         }
-    }
-
-    tc6310.testCaseNumber = "LZ78Y Test";
-    testRun.testCases.push_back(tc6310);
-
-    double h_assessed;
-    h_assessed = data.word_size;
 
-    if ((data.alph_size > 2) || !initial_entropy) {
-        h_assessed = min(h_assessed, H_bitstring * data.word_size);
+        printf("%s\n", testRun.errorMsg.c_str());
+        free_data(&data);
+        exit(-1);
     }
 
-    if (initial_entropy) {
-        h_assessed = min(h_assessed, H_original);
-    }
+    assemble_non_iid_test_cases(&data, initial_entropy, &estimates, testRun.testCases);
+    H_original = estimates.H_original;
+    H_bitstring = estimates.H_bitstring;
+    h_assessed = estimates.h_assessed;
 
     if ((verbose == 1) || (verbose == 2)) {
         if (initial_entropy) {
@@ -519,20 +503,6 @@ int main(int argc, char* argv[]) {
         printf("Assessed min entropy: %.17g\n", h_assessed);
     }
 
-    NonIidTestCase tcOverall;
-
-    if ((data.alph_size > 2) || !initial_entropy) {
-        tcOverall.h_bitstring = H_bitstring;
-    }
-
-    if (initial_entropy) {
-        tcOverall.h_original = H_original;
-    }
-
-    tcOverall.data_word_size = data.word_size;
-    tcOverall.testCaseNumber = "Overall";
-    tcOverall.h_assessed = h_assessed;
-    testRun.testCases.push_back(tcOverall);
     testRun.errorLevel = 0;
 
     if (jsonOutput) {
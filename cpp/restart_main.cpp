@@ -1,6 +1,7 @@
 /* VERSION information is kept in utils.h. Please update when a new version is released */
 
 #include "shared/utils.h"
+#include "shared/restart_simulation.h"
 #include "shared/most_common.h"
 #include "shared/lrs_test.h"
 #include "non_iid/non_iid_test_run.h"
@@ -13,6 +14,7 @@
 #include "non_iid/multi_mcw_test.h"
 #include "non_iid/compression_test.h"
 #include "non_iid/markov_test.h"
+#include "non_iid/non_iid_estimates.h"
 #include "iid/chi_square_tests.h"
 #include "iid/permutation_tests.h"
 
@@ -25,15 +27,28 @@
 
 //Each test has a targeted chance of roughly 0.000005, and we need to witness at least 5 failures, so this should be no less than 1000000
 #define DEFAULT_SIMULATION_ROUNDS 5000000UL
+// Number of rounds that simulateBound simulates at a time
+#define SIMULATION_BLOCK 64
 
 [[ noreturn ]] void print_usage() {
-    printf("Usage is: ea_restart [-i|-n] [-v] [-q] [-s <simulation count>] <file_name> [bits_per_symbol] <H_I>\n\n");
+    printf("Usage is: ea_restart [-i|-n] [-v] [-q] [-e] [-s <simulation count>] [-c <cache directory>] [-f <format>] <file_name> [bits_per_symbol] <H_I>\n");
+    printf("      or: ea_restart [-e] [-s <simulation count>] -c <cache directory> --precompute <H_I_min> <H_I_max> <H_I_step>\n\n");
     printf("\t <file_name>: Must be relative path to a binary file with at least 1 million entries (samples),\n");
     printf("\t and in the \"row dataset\" format described in SP800-90B Section 3.1.4.1.\n");
+    printf("\t Use '-' or '--stdin' to read the samples from standard input (e.g., a pipe).\n");
     printf("\t [bits_per_symbol]: Must be between 1-8, inclusive.\n");
     printf("\t <H_I>: Initial entropy estimate.\n");
     printf("\t [-i|-n]: '-i' for IID data, '-n' for non-IID data. Non-IID is the default.\n");
+    printf("\t -e: Compute the sanity check cutoff exactly, rather than by simulation. With -s, the simulated cutoff is\n");
+    printf("\t also reported, as a cross-check.\n");
     printf("\t -s <simulation count>: Establish cutoff using <simulation count> rounds.\n");
+    printf("\t -c <cache directory>: Read the cutoff from (or add it to) the cutoff cache in <cache directory>. Cutoffs\n");
+    printf("\t are cached by alpha, the number of most likely symbols, H_I (to the millionth of a bit) and the number\n");
+    printf("\t of simulation rounds (or exact computation).\n");
+    printf("\t --precompute: Instead of testing data, fill the cutoff cache for H_I_min, H_I_min + H_I_step, ..., H_I_max.\n");
+    printf("\t -f <format>: Layout of the samples in the file. 'byte' (the default) is one sample per byte, 'msb' and 'lsb'\n");
+    printf("\t are eight 1-bit samples per byte (most / least significant bit first), and 'nibble' is two 4-bit samples\n");
+    printf("\t per byte (high nibble first).\n");
     printf("\t -v: Optional verbosity flag for more output.\n");
     printf("\t -q: Quiet mode, less output to screen.\n");
     printf("\n");
@@ -54,74 +69,26 @@
     exit(-1);
 }
 
-// Here, we simulate a "worst case" for the restart sanity test. This is "worst case" in the sense that the adopted distribution
-// results in the largest acceptable collision bound for a given assessed entropy level, so if a data sample fails this
-// test, it is likely to indicate an underlying problem.
-//
-// This "worst case" uses the "inverted near-uniform" family (see Hagerty-Draper "Entropy Bounds and Statistical Tests" for
-// a full definition of this distribution and justification for its use here).
-//
-// This distribution has as many maximal probability symbols as possible (each occurring with probability p), and possibly one
-// additional symbol that contains all the residual probability.
-//
-// If the probability for the most likely symbol is p, then there are floor(1/p) most likely symbols,
-// each occurring with probability p and possibly one additional symbol that has all the remaining (1 - p floor(1/p)) chance.
-// In this code, we generate a random unit value in the range [0, 1), and we need to map this to one of the ceil(1/p) possible
-// output symbols.
-//
-// Note that the function x -> floor(x/p) yields
-// [0p,1p) -> 0
-// [1p, 2p) -> 1
-// [2p, 3p) -> 2
-// ...
-// [(floor(1/p)-1)p, floor(1/p)p) -> floor(1/p)-1
-// [ floor(1/p)p, 1 ) -> floor(1/p)
-//
-// As such, each of the first floor(1/p) symbols (0 through floor(1/p)-1) have probability p of occurring, and
-// the symbol floor(1/p) has probability 1-floor(1/p)p of occurring, as desired.
-//
-// Note that if floor(1/p) = ceil(1/p) = 1/p, then there is no "residual" symbol, only 1/p most likely symbols.
-//
-// The array is 0-indexed, so we can use this map to establish the index directly.
-uint16_t simulateCount(int k_effective, double p, uint64_t *xoshiro256starstarState) {
-    uint16_t counts[256] = {0};
-    uint16_t max_count = 0;
-
-    for (int j = 0; j < 1000; j++) {
-        // Note that (int)floor(randomUnit(xoshiro256starstarState) / p) is the index map discussed in the above comments.
-        counts[(int)floor(randomUnit(xoshiro256starstarState) / p)]++;
-    }
-
-    // We could have tracked this during the above loop, but that would yield 1000 comparisons,
-    // rather than k_effective (<= 256) comparisons, as here.
-    for (int j = 0; j < k_effective; j++) {
-        if (max_count < counts[j]) max_count = counts[j];
-    }
-
-    return max_count;
-}
-
 //This returns the bound (cutoff) for the test. Counts equal to this value should pass.
 //Larger values should fail.
 
 int simulateBound(double alpha, int k, double H_I, unsigned long int simulation_rounds) {
     uint64_t xoshiro256starstarMainSeed[4];
-    uint16_t *results;
-    long int returnIndex;
+    // histogram[c] is the number of rounds with a maximum count of c. Each count is in [1000/k, 1000], so the
+    // histogram takes the place of an array of all the results (which could be many gigabytes), and its
+    // cumulative sums give the quantiles without a sort.
+    unsigned long int histogram[1001];
+    simulation_map map;
+    unsigned long int blocks;
+    unsigned long int returnIndex;
+    unsigned long int below;
     double p;
     int k_effective;
     int returnValue;
 
     assert((k > 1) && (k <= 256));
 
-    // A few constraints:
-    // This array may be very large (many gigabytes) so can't go onto the stack
-    // Many of the C++ STL-derived types are not thread safe. Our mode of access is
-    // quite straight forward, but there are clearly issues in some cases.
-    // In C, calloc is possibly faster, but this is probably the best we can do
-    // using somewhat idiomatic C++.
-    results = new uint16_t[simulation_rounds];
-    memset(results, 0, sizeof(uint16_t)*simulation_rounds);
+    memset(histogram, 0, sizeof(histogram));
 
     //The probability of the most likely symbol (MLS) only needs to be calculated once...
     p = pow(2.0, -H_I);
@@ -132,34 +99,296 @@ int simulateBound(double alpha, int k, double H_I, unsigned long int simulation_
     k_effective = ceil(1.0 / p);
     assert(k_effective <= k);
 
+    init_simulation_map(&map, p);
+    blocks = (simulation_rounds + SIMULATION_BLOCK - 1) / SIMULATION_BLOCK;
+
     seed(xoshiro256starstarMainSeed);
 
 #pragma omp parallel
     {
-        uint64_t xoshiro256starstarSeed[4];
+        xoshiro_lanes lanes;
+        unsigned long int localHistogram[1001];
+        uint16_t results[SIMULATION_BLOCK];
+
+        memset(localHistogram, 0, sizeof(localHistogram));
+
+        // Each thread has its own RNG lanes, omp_get_thread_num() * XOSHIRO_LANES jumps after the main seed
+        xoshiro_lanes_seed(&lanes, xoshiro256starstarMainSeed, omp_get_thread_num());
 
-        memcpy(xoshiro256starstarSeed, xoshiro256starstarMainSeed, sizeof (xoshiro256starstarMainSeed));
-        //Cause the RNG to jump omp_get_thread_num() * 2^128 calls
-        xoshiro_jump(omp_get_thread_num(), xoshiro256starstarSeed);
+        // Each thread simulates blocks of SIMULATION_BLOCK rounds (as simulateCount does)
+#pragma omp for nowait
+        for (unsigned long int b = 0; b < blocks; b++) {
+            const int rounds = (int)min((unsigned long int)SIMULATION_BLOCK, simulation_rounds - b * SIMULATION_BLOCK);
 
-#pragma omp for
-        for (unsigned long int i = 0; i < simulation_rounds; i++) {
-            results[i] = simulateCount(k_effective, p, xoshiro256starstarSeed);
+            simulateCounts(&map, &lanes, results, rounds);
+            for (int i = 0; i < rounds; i++) localHistogram[results[i]]++;
         }
+
+#pragma omp critical(histogramMerge)
+        for (int c = 0; c <= 1000; c++) histogram[c] += localHistogram[c];
     }
 
-    sort(results, results+simulation_rounds);
-    assert((results[0] >= (1000 / k)) && (results[0] <= 1000));
-    assert((results[simulation_rounds - 1] >= (1000 / k)) && (results[simulation_rounds - 1] <= 1000));
+    for (int c = 0; c < (1000 / k); c++) assert(histogram[c] == 0);
 
     returnIndex = ((size_t) floor((1.0 - alpha) * ((double) simulation_rounds))) - 1;
-    assert((returnIndex >= 0) && (returnIndex < simulation_rounds));
+    assert(returnIndex < simulation_rounds);
+
+    // The result at returnIndex (counting from 0) in the sorted results is the smallest count c with more than
+    // returnIndex results at or below it.
+    below = 0;
+    for (returnValue = 0; returnValue <= 1000; returnValue++) {
+        below += histogram[returnValue];
+        if (below > returnIndex) break;
+    }
+    assert(returnValue <= 1000);
 
-    returnValue = (int)results[returnIndex];
+    return returnValue;
+}
 
-    delete results;
+// The cutoff can also be computed exactly, rather than simulated. The counts of the 1000 samples in the cells of the
+// inverted near-uniform distribution are multinomial. If instead each cell had an independent Poisson count (with
+// mean 1000 times the cell's probability), then those counts, conditioned on their sum being 1000, would have
+// exactly this multinomial distribution. So
+//
+// P(every count <= c) = P(every Poisson count <= c and their sum is 1000) / P(their sum is 1000),
+//
+// where the numerator is coefficient 1000 of the product of the (truncated to 0, ..., c) Poisson probability
+// generating polynomials of the cells, and the sum is Poisson distributed with mean 1000. All the terms are
+// positive, so the products have no cancellation.
+
+// Poisson(lambda) probabilities of 0, ..., c (in logs first, so that large lambda don't underflow)
+void truncatedPoisson(double lambda, int c, vector<double> &pmf) {
+    pmf.assign(c + 1, 0.0);
+    for (int j = 0; j <= c; j++) {
+        pmf[j] = (lambda > 0.0) ? exp(-lambda + j * log(lambda) - lgamma(j + 1.0)) : ((j == 0) ? 1.0 : 0.0);
+    }
+}
 
-    return returnValue;
+// out = a * b, truncated to degree n (out must not be a or b)
+void truncatedProduct(const vector<double> &a, const vector<double> &b, int n, vector<double> &out) {
+    int degree = min(n, (int)(a.size() + b.size()) - 2);
+
+    out.assign(degree + 1, 0.0);
+    for (int i = 0; i < (int)a.size() && i <= degree; i++) {
+        if (a[i] == 0.0) continue;
+        for (int j = 0; j < (int)b.size() && i + j <= degree; j++) out[i + j] += a[i] * b[j];
+    }
+}
+
+// Probability that no count of 1000 samples from the inverted near-uniform distribution (with maximal
+// probability p) exceeds c
+double maxCountCDF(int c, double p) {
+    const int n = 1000;
+    const int m = (int)floor(1.0 / p); // Cells of probability p
+    const bool residual = ((int)ceil(1.0 / p) > m); // The cell with the remaining probability
+    double lambda = n * p * m;
+    vector<double> cell, power, result(1, 1.0), scratch;
+    int e;
+
+    truncatedPoisson(n * p, c, cell);
+
+    // result = cell^m, by squaring
+    power = cell;
+    for (e = m; e > 0; e >>= 1) {
+        if (e & 1) {
+            truncatedProduct(result, power, n, scratch);
+            result.swap(scratch);
+        }
+        if (e > 1) {
+            truncatedProduct(power, power, n, scratch);
+            power.swap(scratch);
+        }
+    }
+
+    if (residual) {
+        truncatedPoisson(n * (1.0 - p * m), c, cell);
+        truncatedProduct(result, cell, n, scratch);
+        result.swap(scratch);
+        lambda += n * (1.0 - p * m);
+    }
+
+    if ((int)result.size() <= n) return 0.0;
+    return result[n] / exp(-lambda + n * log(lambda) - lgamma(n + 1.0));
+}
+
+// The exact value of the cutoff that simulateBound estimates: the smallest count c with P(max count <= c) >= 1 - alpha
+int exactBound(double alpha, int k, double H_I) {
+    double p;
+    int k_effective;
+    int low, high;
+
+    assert((k > 1) && (k <= 256));
+
+    p = pow(2.0, -H_I);
+    k_effective = ceil(1.0 / p);
+    assert(k_effective <= k);
+
+    // The cutoff is in [ceil(1000/k_effective), 1000], and the CDF is non-decreasing in c. The products are cheaper
+    // for small c, so the cutoff is first bracketed by doubling c, then bisected.
+    low = (1000 + k_effective - 1) / k_effective;
+    high = low;
+    while ((high < 1000) && (maxCountCDF(high, p) < 1.0 - alpha)) {
+        low = high + 1;
+        high = min(1000, 2 * high);
+    }
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+
+        if (maxCountCDF(mid, p) >= 1.0 - alpha) high = mid;
+        else low = mid + 1;
+    }
+
+    return low;
+}
+
+// Cutoffs can be cached on disk (-c <directory>), in the text file CUTOFF_CACHE_FILE of the directory. Each line is
+// one cutoff:
+//
+// <alpha> <k_effective> <H_I in units of 1/CUTOFF_CACHE_H_SCALE bits> <simulation rounds (0 when exact)> <X_cutoff>
+//
+// so H_I values that agree when rounded to these units share an entry. Lines are only ever appended, each with a
+// single write, so that concurrent runs can share a cache directory.
+#define CUTOFF_CACHE_FILE "restart_cutoffs.txt"
+#define CUTOFF_CACHE_H_SCALE 1000000.0
+
+string cutoffCachePath(const char *cache_dir) {
+    return string(cache_dir) + "/" + CUTOFF_CACHE_FILE;
+}
+
+bool lookupCutoff(const char *cache_dir, double alpha, int k_effective, long int H_q, unsigned long int rounds, int *X_cutoff) {
+    FILE *cache;
+    char line[256];
+    bool found = false;
+
+    if ((cache = fopen(cutoffCachePath(cache_dir).c_str(), "r")) == NULL) return false;
+
+    while (!found && (fgets(line, sizeof(line), cache) != NULL)) {
+        double line_alpha;
+        int line_k, line_X;
+        long int line_H;
+        unsigned long int line_rounds;
+
+        // Lines that don't parse (e.g., a partially written last line) are skipped
+        if (sscanf(line, "%lf %d %ld %lu %d", &line_alpha, &line_k, &line_H, &line_rounds, &line_X) != 5) continue;
+        if ((line_alpha == alpha) && (line_k == k_effective) && (line_H == H_q) && (line_rounds == rounds)) {
+            *X_cutoff = line_X;
+            found = true;
+        }
+    }
+
+    fclose(cache);
+    return found;
+}
+
+void storeCutoff(const char *cache_dir, double alpha, int k_effective, long int H_q, unsigned long int rounds, int X_cutoff) {
+    char line[256];
+    int fd, len;
+
+    len = snprintf(line, sizeof(line), "%.17g %d %ld %lu %d\n", alpha, k_effective, H_q, rounds, X_cutoff);
+
+    if ((fd = open(cutoffCachePath(cache_dir).c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644)) < 0) {
+        printf("Warning: can't open the cutoff cache %s: %s\n", cutoffCachePath(cache_dir).c_str(), strerror(errno));
+        return;
+    }
+
+    if (write(fd, line, len) != len) {
+        printf("Warning: can't write to the cutoff cache %s: %s\n", cutoffCachePath(cache_dir).c_str(), strerror(errno));
+    }
+
+    close(fd);
+}
+
+// The cutoff for H_I (exact or simulated), read from the cache in cache_dir when it is there (and then *cached is
+// set), otherwise computed and added to the cache. cache_dir may be NULL, for no cache.
+int restartCutoff(double alpha, int k, double H_I, bool exact, unsigned long int simulation_rounds, const char *cache_dir, bool *cached) {
+    const int k_effective = ceil(1.0 / pow(2.0, -H_I));
+    const long int H_q = lround(H_I * CUTOFF_CACHE_H_SCALE);
+    const unsigned long int rounds = exact ? 0 : simulation_rounds;
+    int X_cutoff;
+
+    *cached = (cache_dir != NULL) && lookupCutoff(cache_dir, alpha, k_effective, H_q, rounds, &X_cutoff);
+    if (*cached) return X_cutoff;
+
+    X_cutoff = exact ? exactBound(alpha, k, H_I) : simulateBound(alpha, k, H_I, simulation_rounds);
+    if (cache_dir != NULL) storeCutoff(cache_dir, alpha, k_effective, H_q, rounds, X_cutoff);
+
+    return X_cutoff;
+}
+
+// The --precompute subcommand: fills the cache with the cutoffs of H_I = H_min, H_min + H_step, ..., H_max
+int precomputeCutoffs(double alpha, double H_min, double H_max, double H_step, bool exact, unsigned long int simulation_rounds, const char *cache_dir) {
+    if ((H_min <= 0.0) || (H_max > 8.0) || (H_min > H_max) || (H_step <= 0.0)) {
+        printf("The H_I grid must satisfy 0 < H_I_min <= H_I_max <= 8, with H_I_step > 0.\n");
+        return -1;
+    }
+
+    long int steps = (long int)floor((H_max - H_min) / H_step + 1e-9);
+    for (long int i = 0; i <= steps; i++) {
+        // Grid values are rounded to the cache units, so that they are exactly the entropies of their entries
+        double H_I = lround((H_min + i * H_step) * CUTOFF_CACHE_H_SCALE) / CUTOFF_CACHE_H_SCALE;
+        bool cached;
+        int X_cutoff = restartCutoff(alpha, 256, H_I, exact, simulation_rounds, cache_dir, &cached);
+
+        printf("H_I: %.6f, X_cutoff: %d%s\n", H_I, X_cutoff, cached ? " (cached)" : "");
+    }
+
+    return 0;
+}
+
+// The row and column suites (Section 3.1.4.3) read disjoint copies of the data, so they run concurrently, unless
+// the output is verbose (the estimators then print as they go, and run in the order of their output). The results
+// are merged in the order of the test cases either way, so H_r, H_c and the JSON output don't depend on the timing.
+
+// Tasks are created roughly longest first, so that the long running estimators start early (as in ea_batch)
+static const non_iid_estimator restartTaskOrder[EST_COUNT] = {EST_TUPLE, EST_MULTI_MMC, EST_LZ78Y, EST_MULTI_MCW, EST_LAG, EST_COMPRESSION, EST_MARKOV, EST_COLLISION, EST_MCV};
+
+// The rows and the columns
+#define ROWS 0
+#define COLS 1
+static const char *sideNames[2] = {"Rows", "Cols"};
+
+// Adds the row or column (side) estimate h to the test case, and lowers H_r or H_c (*H) to it. An estimate that
+// failed (is negative) is left out, unless alwaysUsed is set.
+void mergeRestartEstimate(NonIidTestCase &tc, int side, const char *label, double h, bool alwaysUsed, int verbose, double *H) {
+    if (!alwaysUsed && (h < 0)) return;
+
+    if (verbose > 1) printf("\t%s (%s) = %f / %d bit(s)\n", label, sideNames[side], h, (int)tc.data_word_size);
+    if (side == ROWS) tc.h_r = h;
+    else tc.h_c = h;
+    *H = min(h, *H);
+}
+
+// The IID tests, in the order of their output
+#define RESTART_CHI_SQUARE 0
+#define RESTART_LRS 1
+#define RESTART_PERMUTATION 2
+#define RESTART_IID_TESTS 3
+
+// Results of the IID tests on the rows or the columns
+struct restart_iid_results {
+    bool passed[RESTART_IID_TESTS];
+    IidTestCase tc; // receives the permutation test results
+};
+
+void runRestartIidTest(int test, data_t *dp, double rawmean, double median, int verbose, restart_iid_results *res) {
+    switch (test) {
+        case RESTART_CHI_SQUARE:
+            res->passed[test] = chi_square_tests(get_symbols(dp), dp->len, dp->alph_size, verbose);
+            break;
+        case RESTART_LRS:
+            res->passed[test] = len_LRS_test(get_symbols(dp), dp->len, dp->alph_size, verbose, "Literal");
+            break;
+        default:
+            res->passed[test] = permutation_tests(dp, rawmean, median, verbose, res->tc);
+    }
+}
+
+void printRestartIidResult(int test, bool passed, int verbose) {
+    static const char *summaries[RESTART_IID_TESTS] = {"chi square tests", "length of longest repeated substring test", "IID permutation tests"};
+    static const char *names[RESTART_IID_TESTS] = {"Chi square tests", "Length of longest repeated substring test", "IID permutation tests"};
+
+    if ((verbose == 1) || (verbose == 2)) printf("** %s %s\n\n", passed ? "Passed" : "Failed", summaries[test]);
+    else if (verbose > 2) printf("%s: %s\n", names[test], passed ? "Passed" : "Failed");
 }
 
 int main(int argc, char* argv[]) {
@@ -170,23 +399,27 @@ int main(int argc, char* argv[]) {
     int r = 1000, c = 1000;
     int counts[256];
     unsigned long int simulation_rounds = DEFAULT_SIMULATION_ROUNDS;
+    bool exact = false, simulate = false, precompute = false, cached;
+    const char *cache_dir = NULL;
     int X_cutoff;
     int i, j;
     int X_i, X_r, X_c, X_max;
-    double H_I, H_r, H_c, alpha, ret_min_entropy;
+    double H_I, H_r, H_c, alpha;
 	double rawmean, median;
-    uint8_t *rdata, *cdata;
+    uint8_t *rdata, *cdata, *craw;
     unsigned long int inul;
     data_t data;
     int opt;
 
     iid = false;
     data.word_size = 0;
+    data.format = FORMAT_BYTE;
 
     bool jsonOutput = false;
     string timestamp = getCurrentTimestamp();
     string outputfilename = timestamp + ".json";
     string commandline = recreateCommandLine(argc, argv);
+    translateStdinOption(argc, argv);
 
     for (int i = 0; i < argc; i++) {
         std::string Str = std::string(argv[i]);
@@ -194,9 +427,16 @@ int main(int argc, char* argv[]) {
             printVersion("restart");
             exit(0);
         }
+        if ("--precompute" == Str) {
+            // Remove it from the arguments, which are then parsed as usual
+            precompute = true;
+            for (int j = i; j < argc - 1; j++) argv[j] = argv[j + 1];
+            argc--;
+            i--;
+        }
     }
 
-    while ((opt = getopt(argc, argv, "invqo:s:")) != -1) {
+    while ((opt = getopt(argc, argv, "invqeo:s:c:f:")) != -1) {
         switch (opt) {
             case 'i':
                 iid = true;
@@ -210,6 +450,12 @@ int main(int argc, char* argv[]) {
             case 'q':
                 quietMode = true;
                 break;
+            case 'e':
+                exact = true;
+                break;
+            case 'c':
+                cache_dir = optarg;
+                break;
             case 'o':
                 jsonOutput = true;
                 outputfilename = optarg;
@@ -220,8 +466,12 @@ int main(int argc, char* argv[]) {
                     print_usage();
                 } else {
                     simulation_rounds = inul;
+                    simulate = true;
                 }
                 break;
+            case 'f':
+                if (!parse_sample_format(optarg, &data.format)) print_usage();
+                break;
             default:
                 print_usage();
         }
@@ -230,6 +480,14 @@ int main(int argc, char* argv[]) {
     argc -= optind;
     argv += optind;
 
+    if (precompute) {
+        if ((cache_dir == NULL) || (argc != 3)) {
+            printf("Incorrect usage.\n");
+            print_usage();
+        }
+        exit(precomputeCutoffs(1 - exp(log(0.99) / (r + c)), atof(argv[0]), atof(argv[1]), atof(argv[2]), exact, simulation_rounds, cache_dir));
+    }
+
     // Parse args
     if ((argc != 3) && (argc != 2)) {
         printf("Incorrect usage.\n");
@@ -244,19 +502,16 @@ int main(int argc, char* argv[]) {
     if (quietMode) verbose = 0;
 
     char hash[2*SHA256_DIGEST_LENGTH+1];
-    sha256_file(file_path, hash);
 
     IidTestRun testRunIid;
     testRunIid.type = "Restart";
     testRunIid.timestamp = timestamp;
     testRunIid.filename = file_path;
     testRunIid.commandline = commandline;
-    testRunIid.sha256 = hash;
 
     NonIidTestRun testRunNonIid;
     testRunNonIid.type = "Restart";
     testRunNonIid.timestamp = timestamp;
-    testRunNonIid.sha256 = hash;
     testRunNonIid.filename = file_path;
     testRunNonIid.commandline = commandline;
 
@@ -314,9 +569,12 @@ int main(int argc, char* argv[]) {
         print_usage();
     }
 
-    if (verbose > 1) printf("Opening file: '%s' (SHA-256 hash %s)\n", file_path, hash);
+    // The file is hashed while it is being read
+    bool readSuccess = read_file(file_path, &data, &testRunNonIid, hash);
+    testRunIid.sha256 = hash;
+    testRunNonIid.sha256 = hash;
 
-    if (!read_file(file_path, &data, &testRunNonIid)) {
+    if (!readSuccess) {
         printf("Error reading file.\n");
 
         if (jsonOutput) {
@@ -338,6 +596,7 @@ int main(int argc, char* argv[]) {
         print_usage();
     }
 
+    if (verbose > 1) printf("Opening file: '%s' (SHA-256 hash %s)\n", file_path, hash);
     if (verbose > 1) printf("Loaded %ld samples made up of %d distinct %d-bit-wide symbols.\n", data.len, data.alph_size, data.word_size);
 
     if (H_I > data.word_size) {
@@ -412,9 +671,21 @@ int main(int argc, char* argv[]) {
         if (data.alph_size < (1 << data.word_size)) printf("\nSymbols have been translated.\n\n");
     }
 
-    rdata = data.symbols;
+    if (!build_views(&data, VIEW_SYMBOLS, iid ? (TestRunBase*)&testRunIid : (TestRunBase*)&testRunNonIid)) {
+        printf("%s\n", (iid ? testRunIid.errorMsg : testRunNonIid.errorMsg).c_str());
+        if (jsonOutput) {
+            ofstream output;
+            output.open(outputfilename);
+            output << (iid ? testRunIid.GetAsJson() : testRunNonIid.GetAsJson());
+            output.close();
+        }
+        exit(-1);
+    }
+
+    rdata = get_symbols(&data);
     cdata = (uint8_t*) malloc(data.len);
-    if (cdata == NULL) {
+    craw = (uint8_t*) malloc(data.len);
+    if ((cdata == NULL) || (craw == NULL)) {
         printf("Error: failure to initialize memory for columns\n");
         if (jsonOutput) {
             if(iid) {
@@ -439,8 +710,15 @@ int main(int argc, char* argv[]) {
     printf("H_I: %f\n", H_I);
 
     alpha = 1 - exp(log(0.99) / (r + c));
-    X_cutoff = simulateBound(alpha, data.alph_size, H_I, simulation_rounds);
+    X_cutoff = restartCutoff(alpha, data.alph_size, H_I, exact, simulation_rounds, cache_dir, &cached);
     if (verbose > 0) printf("ALPHA: %.17g, X_cutoff: %d\n", alpha, X_cutoff);
+    if (cached && (verbose > 1)) printf("X_cutoff read from the cutoff cache in %s\n", cache_dir);
+
+    // Cross-check the exact cutoff against the simulation, when a simulation count was given
+    if (exact && simulate) {
+        int X_simulated = simulateBound(alpha, data.alph_size, H_I, simulation_rounds);
+        if (verbose > 0) printf("Simulated X_cutoff (%lu rounds): %d\n", simulation_rounds, X_simulated);
+    }
 
     // get maximum row count
     X_r = 0;
@@ -464,6 +742,7 @@ int main(int argc, char* argv[]) {
             //[i*r+j] is row i, column j
             //So, we're fixing a column and iterating through various rows
             cdata[j * c + i] = rdata[i * r + j];
+            craw[j * c + i] = data.rawsymbols[i * r + j];
             if (++counts[cdata[j * c + i]] > X_i) X_i = counts[cdata[j * c + i]];
         }
         if (X_i > X_c) X_c = X_i;
@@ -496,9 +775,6 @@ int main(int argc, char* argv[]) {
 
 
     // Calculate baseline statistics
-    int alphabet_size = data.alph_size;
-    int sample_size = data.len;
-
     if ((verbose == 1) || (verbose == 2))
         printf("Calculating baseline statistics...\n");
 
@@ -514,305 +790,130 @@ int main(int argc, char* argv[]) {
         printf("Running Most Common Value Estimate...\n");
     }
 
-    // Section 6.3.1 - Estimate entropy with Most Common Value
-
-    NonIidTestCase tc631nonIid;
-    tc631nonIid.testCaseNumber = "Most Common Value";
-    tc631nonIid.data_word_size = data.word_size;
-
-    IidTestCase tc631Iid;
-    tc631Iid.testCaseNumber = "Most Common Value";
-    tc631Iid.data_word_size = data.word_size;
-
-    ret_min_entropy = most_common(rdata, data.len, data.alph_size, verbose, "Literal");
-    if (verbose > 1) printf("\tMost Common Value Estimate (Rows) = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-    tc631nonIid.h_r = ret_min_entropy;
-    tc631Iid.h_r = ret_min_entropy;
-
-    H_r = min(ret_min_entropy, H_r);
-
-    ret_min_entropy = most_common(cdata, data.len, data.alph_size, verbose, "Literal");
-    if (verbose > 1) printf("\tMost Common Value Estimate (Cols) = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-    tc631nonIid.h_c = ret_min_entropy;
-    H_c = min(ret_min_entropy, H_c);
-
-    testRunNonIid.testCases.push_back(tc631nonIid);
-
-    IidTestCase tcOverallIid;
-    tcOverallIid.h_r = H_r;
-    tcOverallIid.h_c = H_c;
-    tcOverallIid.h_i = H_I;
-    tcOverallIid.testCaseNumber = "Overall";
-
-
-    if (!iid) {
-
-        if (data.alph_size == 2) {
-
-            if (verbose > 0) printf("\nRunning Entropic Statistic Estimates (bit strings only)...\n");
-
-            // Section 6.3.2 - Estimate entropy with Collision Test (for bit strings only)
-
-            NonIidTestCase tc632;
-            tc632.testCaseNumber = "Collision Test (for bit strings only)";
-            tc632.data_word_size = 1;
-            ret_min_entropy = collision_test(rdata, data.len, verbose, "Literal");
-            if (verbose > 1) printf("\tCollision Test Estimate (Rows) = %f / 1 bit(s)\n", ret_min_entropy);
-            tc632.h_r = ret_min_entropy;
-            H_r = min(ret_min_entropy, H_r);
-
-            ret_min_entropy = collision_test(cdata, data.len, verbose, "Literal");
-            if (verbose > 1) printf("\tCollision Test Estimate (Cols) = %f / 1 bit(s)\n", ret_min_entropy);
-            tc632.h_c = ret_min_entropy;
-            H_c = min(ret_min_entropy, H_c);
-
-            testRunNonIid.testCases.push_back(tc632);
-
-            // Section 6.3.3 - Estimate entropy with Markov Test (for bit strings only)
-
-            NonIidTestCase tc633;
-            tc633.testCaseNumber = "Markov Test (for bit strings only)";
-            tc633.data_word_size = 1;
-
-            ret_min_entropy = markov_test(rdata, data.len, verbose, "Literal");
-            if (verbose > 1) printf("\tMarkov Test Estimate (Rows) = %f / 1 bit(s)\n", ret_min_entropy);
-            tc633.h_r = ret_min_entropy;
-            H_r = min(ret_min_entropy, H_r);
-
-            ret_min_entropy = markov_test(cdata, data.len, verbose, "Literal");
-            if (verbose > 1) printf("\tMarkov Test Estimate (Cols) = %f / 1 bit(s)\n", ret_min_entropy);
-            tc633.h_c = ret_min_entropy;
-            H_c = min(ret_min_entropy, H_c);
-
-            testRunNonIid.testCases.push_back(tc633);
-
-            // Section 6.3.4 - Estimate entropy with Compression Test (for bit strings only)
+    // Sections 6.3.1 - 6.3.10 - Estimate entropy with the non-IID estimators (only with the Most Common Value for IID data)
+
+    const bool concurrent = (verbose <= 1);
+    bool applies[EST_COUNT];
+    data_t data_col;
+    data_t *sides[2] = {&data, &data_col};
+    non_iid_estimates estimates[2];
+    double *H[2] = {&H_r, &H_c};
+
+    // The columns share everything but the samples with the rows
+    memcpy(&data_col, &data, sizeof(data));
+    data_col.symbols = cdata;
+    data_col.rawsymbols = craw;
+    data_col.bsymbols = NULL;
+    data_col.pbsymbols = NULL;
+    data_col.mapping = NULL;
+
+    for (int i = 0; i < EST_COUNT; i++) {
+        non_iid_estimator est = (non_iid_estimator)i;
+        applies[est] = (est == EST_MCV) || (!iid && non_iid_estimate_applies(&data, true, est, HALF_LITERAL));
+    }
 
-            NonIidTestCase tc634;
-            tc634.testCaseNumber = "Compression Test (for bit strings only)";
-            tc634.data_word_size = 1;
+    init_non_iid_estimates(&estimates[ROWS]);
+    init_non_iid_estimates(&estimates[COLS]);
 
-            ret_min_entropy = compression_test(rdata, data.len, verbose, "Literal");
-            if (ret_min_entropy >= 0) {
-                if (verbose > 1) printf("\tCompression Test Estimate (Rows) = %f / 1 bit(s)\n", ret_min_entropy);
-                tc634.h_r = ret_min_entropy;
-                H_r = min(ret_min_entropy, H_r);
-            }
+    if (concurrent) {
+        #pragma omp parallel
+        {
+            #pragma omp single
+            for (int i = 0; i < EST_COUNT; i++) {
+                non_iid_estimator est = restartTaskOrder[i];
+                if (!applies[est]) continue;
 
-            ret_min_entropy = compression_test(cdata, data.len, verbose, "Literal");
-            if (ret_min_entropy >= 0) {
-                if (verbose > 1) printf("\tCompression Test Estimate (Cols) = %f / 1 bit(s)\n", ret_min_entropy);
-                tc634.h_c = ret_min_entropy;
-                H_c = min(ret_min_entropy, H_c);
+                for (int side = ROWS; side <= COLS; side++) {
+                    #pragma omp task firstprivate(est, side)
+                    run_non_iid_estimate(sides[side], est, HALF_LITERAL, &estimates[side]);
+                }
             }
-            testRunNonIid.testCases.push_back(tc634);
-
-        }
-
-
-        if (verbose > 0) printf("\nRunning Tuple Estimates...\n");
-
-        // Section 6.3.5 - Estimate entropy with t-Tuple Test
-
-        NonIidTestCase tc635;
-        tc635.testCaseNumber = "T-Tuple Test";
-        tc635.data_word_size = data.word_size;
-
-        double row_t_tuple_res, row_lrs_res;
-        double col_t_tuple_res, col_lrs_res;
-        SAalgs(rdata, data.len, data.alph_size, row_t_tuple_res, row_lrs_res, verbose, "Literal");
-        SAalgs(cdata, data.len, data.alph_size, col_t_tuple_res, col_lrs_res, verbose, "Literal");
-
-        if (verbose > 1) printf("\tT-Tuple Test Estimate (Rows) = %f / %d bit(s)\n", row_t_tuple_res, data.word_size);
-        tc635.h_r = row_t_tuple_res;
-        H_r = min(row_t_tuple_res, H_r);
-
-        if (verbose > 1) printf("\tT-Tuple Test Estimate (Cols) = %f / %d bit(s)\n", col_t_tuple_res, data.word_size);
-        tc635.h_c = col_t_tuple_res;
-        H_c = min(col_t_tuple_res, H_c);
-
-        testRunNonIid.testCases.push_back(tc635);
-        // Section 6.3.6 - Estimate entropy with LRS Test
-
-        NonIidTestCase tc636;
-        tc636.testCaseNumber = "LRS Test";
-        tc636.data_word_size = data.word_size;
-
-        if (verbose > 1) printf("\tLRS Test Estimate (Rows) = %f / %d bit(s)\n", row_lrs_res, data.word_size);
-        tc636.h_r = row_lrs_res;
-        H_r = min(row_lrs_res, H_r);
-
-        if (verbose > 1) printf("\tLRS Test Estimate (Cols) = %f / %d bit(s)\n", col_lrs_res, data.word_size);
-        tc636.h_c = col_lrs_res;
-        H_c = min(col_lrs_res, H_c);
-
-        testRunNonIid.testCases.push_back(tc636);
-
-        if (verbose > 0) printf("\nRunning Predictor Estimates...\n");
-
-        // Section 6.3.7 - Estimate entropy with Multi Most Common in Window Test
-
-        NonIidTestCase tc637;
-        tc637.testCaseNumber = "Multi Most Common in Window Test";
-        tc637.data_word_size = data.word_size;
-
-        ret_min_entropy = multi_mcw_test(rdata, data.len, data.alph_size, verbose, "Literal");
-        if (ret_min_entropy >= 0) {
-            if (verbose > 1) printf("\tMulti Most Common in Window (MultiMCW) Prediction Test Estimate (Rows) = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-            tc637.h_r = ret_min_entropy;
-            H_r = min(ret_min_entropy, H_r);
-        }
-
-        ret_min_entropy = multi_mcw_test(cdata, data.len, data.alph_size, verbose, "Literal");
-        if (ret_min_entropy >= 0) {
-            if (verbose > 1) printf("\tMulti Most Common in Window (MultiMCW) Prediction Test Estimate (Cols) = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-            tc637.h_c = ret_min_entropy;
-            H_c = min(ret_min_entropy, H_c);
         }
+    }
 
-        testRunNonIid.testCases.push_back(tc637);
-        // Section 6.3.8 - Estimate entropy with Lag Prediction Test
+    for (int i = 0; i < EST_COUNT; i++) {
+        non_iid_estimator est = (non_iid_estimator)i;
+        // The most common value, collision, Markov, t-Tuple and LRS estimates are always used; the others only when they succeeded
+        const bool alwaysUsed = (est == EST_MCV) || (est == EST_COLLISION) || (est == EST_MARKOV) || (est == EST_TUPLE);
+        const bool bitsOnly = (est == EST_COLLISION) || (est == EST_MARKOV) || (est == EST_COMPRESSION);
+        NonIidTestCase tc;
 
-        NonIidTestCase tc638;
-        tc638.testCaseNumber = "Lag Prediction Test";
-        tc638.data_word_size = data.word_size;
+        if (!applies[est]) continue;
 
-        ret_min_entropy = lag_test(rdata, data.len, data.alph_size, verbose, "Literal");
-        if (ret_min_entropy >= 0) {
-            if (verbose > 1) printf("\tLag Prediction Test Estimate (Rows) = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-            tc638.h_r = ret_min_entropy;
-            H_r = min(ret_min_entropy, H_r);
+        if (verbose > 0) {
+            if (est == EST_COLLISION) printf("\nRunning Entropic Statistic Estimates (bit strings only)...\n");
+            else if (est == EST_TUPLE) printf("\nRunning Tuple Estimates...\n");
+            else if (est == EST_MULTI_MCW) printf("\nRunning Predictor Estimates...\n");
         }
 
-        ret_min_entropy = lag_test(cdata, data.len, data.alph_size, verbose, "Literal");
-        if (ret_min_entropy >= 0) {
-            if (verbose > 1) printf("\tLag Prediction Test Estimate (Cols) = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-            tc638.h_c = ret_min_entropy;
-            H_c = min(ret_min_entropy, H_c);
-        }
-        testRunNonIid.testCases.push_back(tc638);
-
-        // Section 6.3.9 - Estimate entropy with Multi Markov Model with Counting Test (MultiMMC)
-        NonIidTestCase tc639;
-        tc639.testCaseNumber = "Multi Markov Model with Counting Test (MultiMMC)";
-        tc639.data_word_size = data.word_size;
-
-        ret_min_entropy = multi_mmc_test(rdata, data.len, data.alph_size, verbose, "Literal");
-        if (ret_min_entropy >= 0) {
-            if (verbose > 1) printf("\tMulti Markov Model with Counting (MultiMMC) Prediction Test Estimate (Rows) = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-            tc639.h_r = ret_min_entropy;
-            H_r = min(ret_min_entropy, H_r);
-        }
+        tc.testCaseNumber = nonIidTestCaseNames[est];
+        tc.data_word_size = bitsOnly ? 1 : data.word_size;
 
-        ret_min_entropy = multi_mmc_test(cdata, data.len, data.alph_size, verbose, "Literal");
-        if (ret_min_entropy >= 0) {
-            if (verbose > 1) printf("\tMulti Markov Model with Counting (MultiMMC) Prediction Test Estimate (Cols) = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-            tc639.h_c = ret_min_entropy;
-            H_c = min(ret_min_entropy, H_c);
+        // When not concurrent, each estimate is reported as soon as it is made (the t-Tuple and LRS estimates, which
+        // come from the same run, once both sides are done)
+        for (int side = ROWS; side <= COLS; side++) {
+            if (!concurrent) run_non_iid_estimate(sides[side], est, HALF_LITERAL, &estimates[side], verbose);
+            if (est != EST_TUPLE) mergeRestartEstimate(tc, side, nonIidEstimateLabels[est], estimates[side].h[est][HALF_LITERAL], alwaysUsed, verbose, H[side]);
         }
-        testRunNonIid.testCases.push_back(tc639);
-
-        // Section 6.3.10 - Estimate entropy with LZ78Y Test
 
-        NonIidTestCase tc6310;
-        tc6310.testCaseNumber = "LZ78Y Test";
-        tc6310.data_word_size = data.word_size;
+        if (est == EST_TUPLE) {
+            NonIidTestCase tcLrs;
+            tcLrs.testCaseNumber = "LRS Test";
+            tcLrs.data_word_size = data.word_size;
 
-        ret_min_entropy = LZ78Y_test(rdata, data.len, data.alph_size, verbose, "Literal");
-        if (ret_min_entropy >= 0) {
-            if (verbose > 1) printf("\tLZ78Y Prediction Test Estimate (Rows) = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-            tc6310.h_r = ret_min_entropy;
-            H_r = min(ret_min_entropy, H_r);
-        }
+            for (int side = ROWS; side <= COLS; side++) mergeRestartEstimate(tc, side, nonIidEstimateLabels[est], estimates[side].h[est][HALF_LITERAL], alwaysUsed, verbose, H[side]);
+            testRunNonIid.testCases.push_back(tc);
 
-        ret_min_entropy = LZ78Y_test(cdata, data.len, data.alph_size, verbose, "Literal");
-        if (ret_min_entropy >= 0) {
-            if (verbose > 1) printf("\tLZ78Y Prediction Test Estimate (Cols) = %f / %d bit(s)\n", ret_min_entropy, data.word_size);
-            tc6310.h_c = ret_min_entropy;
-            H_c = min(ret_min_entropy, H_c);
+            for (int side = ROWS; side <= COLS; side++) mergeRestartEstimate(tcLrs, side, "LRS Test Estimate", estimates[side].lrs[HALF_LITERAL], true, verbose, H[side]);
+            testRunNonIid.testCases.push_back(tcLrs);
+        } else {
+            testRunNonIid.testCases.push_back(tc);
         }
-        testRunNonIid.testCases.push_back(tc6310);
+    }
 
-    } else { /* IID tests */
+    IidTestCase tcOverallIid;
+    tcOverallIid.h_r = H_r;
+    tcOverallIid.h_c = H_c;
+    tcOverallIid.h_i = H_I;
+    tcOverallIid.testCaseNumber = "Overall";
 
-        // Compute chi square stats
-        bool chi_square_test_pass_row = chi_square_tests(rdata, sample_size, alphabet_size, verbose);
-        bool chi_square_test_pass_col = chi_square_tests(cdata, sample_size, alphabet_size, verbose);
-        bool chi_square_test_pass = chi_square_test_pass_row && chi_square_test_pass_col;
+    if (iid) {
+        restart_iid_results iidResults[2];
 
-        tcOverallIid.passed_chi_square_tests = chi_square_test_pass;
+        if (concurrent) {
+            // One thread per suite, each with half of the threads for its permutation tests (with a single thread,
+            // the suites run one after the other)
+            const int threads = omp_get_max_threads();
+            const int levels = omp_get_max_active_levels();
 
-        if ((verbose == 1) || (verbose == 2)) {
-            if (chi_square_test_pass) {
-                printf("** Passed chi square tests\n\n");
-            }
-            else {
-                printf("** Failed chi square tests\n\n");
+            omp_set_max_active_levels(2);
+            #pragma omp parallel for num_threads(min(2, threads)) schedule(static, 1)
+            for (int side = ROWS; side <= COLS; side++) {
+                omp_set_num_threads(max(1, (threads + 1 - side) / 2));
+                for (int test = 0; test < RESTART_IID_TESTS; test++) runRestartIidTest(test, sides[side], rawmean, median, verbose, &iidResults[side]);
             }
+            omp_set_max_active_levels(levels);
         }
-        else if (verbose > 2) {
-            if (chi_square_test_pass) {
-                printf("Chi square tests: Passed\n");
-            }
-            else {
-                printf("Chi square tests: Failed\n");
-            }
-        }
-
-        // Compute length of the longest repeated substring stats
-        bool len_LRS_test_pass_row = len_LRS_test(rdata, sample_size, alphabet_size, verbose, "Literal");
-        bool len_LRS_test_pass_col = len_LRS_test(cdata, sample_size, alphabet_size, verbose, "Literal");
-        bool len_LRS_test_pass = len_LRS_test_pass_row && len_LRS_test_pass_col;
 
-        tcOverallIid.passed_longest_repeated_substring_test = len_LRS_test_pass;
-
-        if ((verbose == 1) || (verbose == 2)) {
-            if (len_LRS_test_pass) {
-                printf("** Passed length of longest repeated substring test\n\n");
-            }
-            else {
-                printf("** Failed length of longest repeated substring test\n\n");
+        for (int test = 0; test < RESTART_IID_TESTS; test++) {
+            if (!concurrent) {
+                for (int side = ROWS; side <= COLS; side++) runRestartIidTest(test, sides[side], rawmean, median, verbose, &iidResults[side]);
             }
-        }
-        else if (verbose > 2) {
-            if (len_LRS_test_pass) {
-                printf("Length of longest repeated substring test: Passed\n");
-            }
-            else {
-                printf("Length of longest repeated substring test: Failed\n");
-            }
-        }
 
-        // Compute permutation stats
-        bool perm_test_pass_row = permutation_tests(&data, rawmean, median, verbose, tcOverallIid);
+            bool passed = iidResults[ROWS].passed[test] && iidResults[COLS].passed[test];
 
-        data_t data_col;
-        memcpy(&data_col, &data, sizeof(data));
-        data_col.symbols = rdata;
+            if (test == RESTART_CHI_SQUARE) tcOverallIid.passed_chi_square_tests = passed;
+            else if (test == RESTART_LRS) tcOverallIid.passed_longest_repeated_substring_test = passed;
+            else tcOverallIid.passed_iid_permutation_tests = passed;
 
-        bool perm_test_pass_col = permutation_tests(&data_col, rawmean, median, verbose, tcOverallIid);
-        bool perm_test_pass = perm_test_pass_row && perm_test_pass_col;
-
-        tcOverallIid.passed_iid_permutation_tests = perm_test_pass;
-
-        if ((verbose == 1) || (verbose == 2)) {
-            if (perm_test_pass) {
-                printf("** Passed IID permutation tests\n\n");
-            }
-            else {
-                printf("** Failed IID permutation tests\n\n");
-            }
-        }
-        else if (verbose > 2) {
-            if (perm_test_pass) {
-                printf("IID permutation tests: Passed\n");
-            }
-            else {
-                printf("IID permutation tests: Failed\n");
-            }
+            printRestartIidResult(test, passed, verbose);
         }
 
-
+        // The permutation test results of the rows, then those of the columns
+        for (int side = ROWS; side <= COLS; side++) {
+            vector<PermutationTestResult> &results = iidResults[side].tc.testResults;
+            tcOverallIid.testResults.insert(tcOverallIid.testResults.end(), results.begin(), results.end());
+        }
     }
 
     if (verbose > 0) {
@@ -874,6 +975,7 @@ int main(int argc, char* argv[]) {
         printf("min(H_r, H_c, H_I): %f\n\n", min(min(H_r, H_c), H_I));
     }
     free(cdata);
+    free(craw);
     free_data(&data);
     return 0;
 }
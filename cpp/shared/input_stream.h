@@ -0,0 +1,306 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+
+#include <bzlib.h>
+#include <zlib.h>
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+// Compression formats recognized by their headers
+enum compression_t {
+	COMPRESSION_NONE = 0,
+	COMPRESSION_BZIP2,
+	COMPRESSION_GZIP,
+	COMPRESSION_ZSTD
+};
+
+// Number of leading bytes needed by detect_compression()
+#define COMPRESSION_MAGIC_LEN 10
+
+// Raw samples can start with the magic bytes of a format (about one in 65536 byte captures starts with the gzip
+// magic), so the fixed fields that follow the magic are checked too: the bzip2 block (or end of stream) magic,
+// the gzip compression method (deflate) and reserved flags, and the reserved bit of the zstd frame header.
+compression_t detect_compression(const uint8_t *magic, size_t len) {
+	static const uint8_t bzip2Block[6] = {0x31, 0x41, 0x59, 0x26, 0x53, 0x59};
+	static const uint8_t bzip2End[6] = {0x17, 0x72, 0x45, 0x38, 0x50, 0x90};
+
+	if((len >= 10) && (magic[0] == 'B') && (magic[1] == 'Z') && (magic[2] == 'h') && (magic[3] >= '1') && (magic[3] <= '9') &&
+		((memcmp(magic + 4, bzip2Block, 6) == 0) || (memcmp(magic + 4, bzip2End, 6) == 0))) return COMPRESSION_BZIP2;
+	if((len >= 4) && (magic[0] == 0x1F) && (magic[1] == 0x8B) && (magic[2] == 0x08) && ((magic[3] & 0xE0) == 0)) return COMPRESSION_GZIP;
+	if((len >= 5) && (magic[0] == 0x28) && (magic[1] == 0xB5) && (magic[2] == 0x2F) && (magic[3] == 0xFD) && ((magic[4] & 0x08) == 0)) return COMPRESSION_ZSTD;
+
+	return COMPRESSION_NONE;
+}
+
+const char *compression_name(compression_t type) {
+	switch(type) {
+		case COMPRESSION_BZIP2: return "bzip2";
+		case COMPRESSION_GZIP: return "gzip";
+		case COMPRESSION_ZSTD: return "zstd";
+		default: return "uncompressed";
+	}
+}
+
+// Sequential reader over a file descriptor that transparently decompresses bzip2, gzip or zstd data.
+// Bytes that were already consumed from the descriptor while sniffing the format (prefix) are delivered first.
+// Concatenated streams (as written by pbzip2, pigz, or cat) are decoded one after the other.
+class input_stream {
+	int fd;
+	compression_t type;
+
+	uint8_t *inbuf;
+	size_t inLen;		// bytes in inbuf
+	size_t inPos;		// bytes of inbuf already consumed
+	bool inEof;		// the descriptor is exhausted
+	bool streamOpen;	// a compressed stream is being decoded
+	bool failed;
+	std::string reason;	// why the data couldn't be read or decoded
+
+	bz_stream bz;
+	z_stream z;
+#ifdef ENABLE_ZSTD
+	ZSTD_DStream *zs;
+	size_t zsHint;		// last return value of ZSTD_decompressStream (non-zero within a frame)
+#endif
+
+	static const size_t bufSize = 1UL << 20;
+
+	// Record the first error; returns -1 for the readers
+	long fail(const std::string &why) {
+		if(reason.empty()) reason = why;
+		return -1;
+	}
+
+	static const char *bzip2_error(int ret) {
+		switch(ret) {
+			case BZ_DATA_ERROR: return "data integrity error";
+			case BZ_DATA_ERROR_MAGIC: return "bad stream magic";
+			case BZ_MEM_ERROR: return "out of memory";
+			default: return "decoding error";
+		}
+	}
+
+	// Make sure that there is unconsumed input, unless the descriptor is exhausted
+	bool refill() {
+		long rc;
+
+		if((inPos < inLen) || inEof) return true;
+
+		inPos = 0;
+		inLen = 0;
+		do {
+			rc = ::read(fd, inbuf, bufSize);
+		} while((rc < 0) && (errno == EINTR));
+
+		if(rc < 0) {
+			fail(strerror(errno));
+			return false;
+		}
+		if(rc == 0) inEof = true;
+		inLen = (size_t)rc;
+
+		return true;
+	}
+
+	bool openStream() {
+		switch(type) {
+			case COMPRESSION_BZIP2:
+				memset(&bz, 0, sizeof(bz));
+				streamOpen = (BZ2_bzDecompressInit(&bz, 0, 0) == BZ_OK);
+				break;
+			case COMPRESSION_GZIP:
+				memset(&z, 0, sizeof(z));
+				// 16 + MAX_WBITS: expect a gzip header and trailer
+				streamOpen = (inflateInit2(&z, 16 + MAX_WBITS) == Z_OK);
+				break;
+			default:
+				streamOpen = false;
+				break;
+		}
+
+		if(!streamOpen) fail("can't initialize the decoder");
+		return streamOpen;
+	}
+
+	void closeStream() {
+		if(!streamOpen) return;
+		if(type == COMPRESSION_BZIP2) BZ2_bzDecompressEnd(&bz);
+		else if(type == COMPRESSION_GZIP) inflateEnd(&z);
+		streamOpen = false;
+	}
+
+	long readBzip2(uint8_t *out, long len) {
+		long produced = 0;
+
+		while(produced == 0) {
+			if(!refill()) return -1;
+			if(!streamOpen) {
+				// Only start another stream if there is more data
+				if(inPos == inLen) return 0;
+				if(!openStream()) return -1;
+			}
+
+			bz.next_in = (char*)(inbuf + inPos);
+			bz.avail_in = (unsigned int)(inLen - inPos);
+			bz.next_out = (char*)out;
+			bz.avail_out = (unsigned int)len;
+
+			int ret = BZ2_bzDecompress(&bz);
+			inPos = inLen - bz.avail_in;
+			produced = len - bz.avail_out;
+
+			if(ret == BZ_STREAM_END) closeStream();
+			else if(ret != BZ_OK) return fail(bzip2_error(ret));
+			else if((produced == 0) && inEof && (inPos == inLen)) return fail("truncated stream");
+		}
+
+		return produced;
+	}
+
+	long readGzip(uint8_t *out, long len) {
+		long produced = 0;
+
+		while(produced == 0) {
+			if(!refill()) return -1;
+			if(!streamOpen) {
+				if(inPos == inLen) return 0;
+				if(!openStream()) return -1;
+			}
+
+			z.next_in = inbuf + inPos;
+			z.avail_in = (uInt)(inLen - inPos);
+			z.next_out = out;
+			z.avail_out = (uInt)len;
+
+			int ret = inflate(&z, Z_NO_FLUSH);
+			inPos = inLen - z.avail_in;
+			produced = len - z.avail_out;
+
+			if(ret == Z_STREAM_END) closeStream();
+			else if((ret != Z_OK) && (ret != Z_BUF_ERROR)) return fail((z.msg != NULL) ? z.msg : "decoding error");
+			else if((produced == 0) && inEof && (inPos == inLen)) return fail("truncated stream");
+		}
+
+		return produced;
+	}
+
+#ifdef ENABLE_ZSTD
+	long readZstd(uint8_t *out, long len) {
+		ZSTD_outBuffer output = { out, (size_t)len, 0 };
+
+		while(output.pos == 0) {
+			if(!refill()) return -1;
+			if(inPos == inLen) {
+				// The data must not end within a frame
+				return (zsHint == 0) ? 0 : fail("truncated stream");
+			}
+
+			ZSTD_inBuffer input = { inbuf + inPos, inLen - inPos, 0 };
+			zsHint = ZSTD_decompressStream(zs, &output, &input);
+			if(ZSTD_isError(zsHint)) return fail(ZSTD_getErrorName(zsHint));
+			inPos += input.pos;
+		}
+
+		return (long)output.pos;
+	}
+#endif
+
+public:
+	input_stream(int fd, compression_t type, const uint8_t *prefix, size_t prefixLen) : fd(fd), type(type), inLen(0), inPos(0), inEof(false), streamOpen(false), failed(false) {
+		inbuf = new uint8_t[bufSize];
+		if(prefixLen > 0) memcpy(inbuf, prefix, prefixLen);
+		inLen = prefixLen;
+
+#ifdef ENABLE_ZSTD
+		zs = NULL;
+		zsHint = 0;
+		if(type == COMPRESSION_ZSTD) {
+			zs = ZSTD_createDStream();
+			if((zs == NULL) || ZSTD_isError(ZSTD_initDStream(zs))) {
+				failed = true;
+				fail("can't initialize the decoder");
+			}
+		}
+#else
+		if(type == COMPRESSION_ZSTD) {
+			failed = true;
+			fail("zstd support is not built in (build with ZSTD=1)");
+		}
+#endif
+	}
+
+	~input_stream() {
+		closeStream();
+#ifdef ENABLE_ZSTD
+		if(zs != NULL) ZSTD_freeDStream(zs);
+#endif
+		delete[] inbuf;
+	}
+
+	// False if the decoder could not be set up (e.g., zstd input in a build without zstd support)
+	bool ok() const {
+		return !failed;
+	}
+
+	compression_t compression() const {
+		return type;
+	}
+
+	// Why the decoder couldn't be set up or the last read failed (empty if it didn't)
+	const std::string &error() const {
+		return reason;
+	}
+
+	// Read up to len (decompressed) bytes. Returns the number of bytes read, 0 at the end of the data,
+	// or -1 on a read or decoding error.
+	long read(uint8_t *out, long len) {
+		long rc;
+
+		if(failed) return -1;
+		if(len <= 0) return 0;
+
+		// The decoders count in unsigned int
+		if(len > (1L << 30)) len = 1L << 30;
+
+		switch(type) {
+			case COMPRESSION_BZIP2:
+				rc = readBzip2(out, len);
+				break;
+			case COMPRESSION_GZIP:
+				rc = readGzip(out, len);
+				break;
+#ifdef ENABLE_ZSTD
+			case COMPRESSION_ZSTD:
+				rc = readZstd(out, len);
+				break;
+#endif
+			case COMPRESSION_NONE:
+				if(inPos < inLen) {
+					// Deliver the prefix first
+					rc = std::min((long)(inLen - inPos), len);
+					memcpy(out, inbuf + inPos, rc);
+					inPos += rc;
+				} else {
+					do {
+						rc = ::read(fd, out, len);
+					} while((rc < 0) && (errno == EINTR));
+					if(rc < 0) fail(strerror(errno));
+				}
+				break;
+			default:
+				rc = -1;
+				break;
+		}
+
+		if(rc < 0) failed = true;
+		return rc;
+	}
+};
@@ -3,24 +3,11 @@
 #include "../shared/test_case_base.h"
 #include <string>
 
-// Section 6.3.1 - Most Common Value Estimate
-double most_common(uint8_t* data, const long len, const int alph_size, const int verbose, const char *label, TestCaseBase &tc){
-
-	long counts[alph_size];
-	long i, mode;
+// Section 6.3.1 - Most Common Value Estimate, given the count of the most common value
+static double most_common_estimate(const long mode, const long len, const int verbose, const char *label, TestCaseBase &tc){
 	double pmax, ubound;
 	double entEst;
 
-	assert(len > 1);
-
-	for(i = 0; i < alph_size; i++) counts[i] = 0;
-	for (i = 0; i < len; i++) counts[data[i]]++;
-
-	mode = 0;
-	for(i = 0; i < alph_size; i++){
-		if(counts[i] > mode) mode = counts[i];
-	}
-
 	pmax = mode/(double)len;
 
 	ubound = min(1.0,pmax + ZALPHA*sqrt(pmax*(1.0-pmax)/(len-1.0)));
@@ -42,6 +29,37 @@ double most_common(uint8_t* data, const long len, const int alph_size, const int
 	return entEst;
 }
 
+// Section 6.3.1 - Most Common Value Estimate
+double most_common(uint8_t* data, const long len, const int alph_size, const int verbose, const char *label, TestCaseBase &tc){
+
+	long counts[alph_size];
+	long i, mode;
+
+	assert(len > 1);
+
+	for(i = 0; i < alph_size; i++) counts[i] = 0;
+	for (i = 0; i < len; i++) counts[data[i]]++;
+
+	mode = 0;
+	for(i = 0; i < alph_size; i++){
+		if(counts[i] > mode) mode = counts[i];
+	}
+
+	return most_common_estimate(mode, len, verbose, label, tc);
+}
+
+// Section 6.3.1 - Most Common Value Estimate for a packed bitstring (see pack_symbols)
+// The mode is just the larger of the counts of ones and zeros, so this reduces to a popcount.
+double most_common(const uint64_t* data, const long len, const int verbose, const char *label, TestCaseBase &tc){
+	long ones;
+
+	assert(len > 1);
+
+	ones = packed_popcount(data, 0, len);
+
+	return most_common_estimate(max(ones, len - ones), len, verbose, label, tc);
+}
+
 //Wrapper method needed because some runs do not get output as JSON currently
 //and therefore do not have a TestCase object to send (restart tests)
 double most_common(uint8_t* data, const long len, const int alph_size, const int verbose, const char *label){
@@ -50,3 +68,10 @@ double most_common(uint8_t* data, const long len, const int alph_size, const int
    return most_common(data, len, alph_size, verbose, label, dummy);    
    
 }
+
+double most_common(const uint64_t* data, const long len, const int verbose, const char *label){
+
+   TestCaseBase dummy;
+   return most_common(data, len, verbose, label, dummy);
+
+}
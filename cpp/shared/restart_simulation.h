@@ -0,0 +1,122 @@
+#pragma once
+
+#include "utils.h"
+
+// Here, we simulate a "worst case" for the restart sanity test. This is "worst case" in the sense that the adopted distribution
+// results in the largest acceptable collision bound for a given assessed entropy level, so if a data sample fails this
+// test, it is likely to indicate an underlying problem.
+//
+// This "worst case" uses the "inverted near-uniform" family (see Hagerty-Draper "Entropy Bounds and Statistical Tests" for
+// a full definition of this distribution and justification for its use here).
+//
+// This distribution has as many maximal probability symbols as possible (each occurring with probability p), and possibly one
+// additional symbol that contains all the residual probability.
+//
+// If the probability for the most likely symbol is p, then there are floor(1/p) most likely symbols,
+// each occurring with probability p and possibly one additional symbol that has all the remaining (1 - p floor(1/p)) chance.
+// In this code, we generate a random unit value in the range [0, 1), and we need to map this to one of the ceil(1/p) possible
+// output symbols.
+//
+// Note that the function x -> floor(x/p) yields
+// [0p,1p) -> 0
+// [1p, 2p) -> 1
+// [2p, 3p) -> 2
+// ...
+// [(floor(1/p)-1)p, floor(1/p)p) -> floor(1/p)-1
+// [ floor(1/p)p, 1 ) -> floor(1/p)
+//
+// As such, each of the first floor(1/p) symbols (0 through floor(1/p)-1) have probability p of occurring, and
+// the symbol floor(1/p) has probability 1-floor(1/p)p of occurring, as desired.
+//
+// Note that if floor(1/p) = ceil(1/p) = 1/p, then there is no "residual" symbol, only 1/p most likely symbols.
+//
+// The array is 0-indexed, so we can use this map to establish the index directly.
+uint16_t simulateCount(int k_effective, double p, xoshiro_lanes *g) {
+	uint16_t counts[256] = {0};
+	uint16_t max_count = 0;
+	double u[1000];
+
+	// The 1000 unit values are drawn in one block
+	fill_unit_double(g, u, 1000);
+
+	for (int j = 0; j < 1000; j++) {
+		// Note that (int)floor(u[j] / p) is the index map discussed in the above comments.
+		counts[(int)floor(u[j] / p)]++;
+	}
+
+	// We could have tracked this during the above loop, but that would yield 1000 comparisons,
+	// rather than k_effective (<= 256) comparisons, as here.
+	for (int j = 0; j < k_effective; j++) {
+		if (max_count < counts[j]) max_count = counts[j];
+	}
+
+	return max_count;
+}
+
+// The batched version of simulateCount, which simulates rounds in blocks. For each round, the 1000 random words are
+// drawn in one fill, and each is mapped to its index with a multiply by a precomputed reciprocal and a truncation. The
+// indices are counted into SIMULATION_HISTOGRAMS sub-histograms, so that consecutive increments of the same count
+// don't wait on each other.
+
+#define SIMULATION_HISTOGRAMS 4
+// A multiplied value this close to an integer may truncate to a different index than simulateCount's division; the
+// round's indices are then computed with the division (the rounding errors of either are under 1e-13)
+#define SIMULATION_MARGIN 1e-9
+
+// The index map of simulateCount for one p. The unit value of a random word j (the top 53 bits of an RNG output) is
+// j * 2^-53, so its index is about j * scale.
+struct simulation_map {
+	double p;
+	double scale;		// 2^-53 / p
+	int k_effective;
+};
+
+void init_simulation_map(simulation_map *map, double p) {
+	map->p = p;
+	map->scale = 1.1102230246251565e-16 / p;
+	map->k_effective = ceil(1.0 / p);
+}
+
+// Writes the results of rounds rounds of simulateCount (for the p of map) to results. For the same lanes, the results
+// are the same as those of rounds calls to simulateCount.
+void simulateCounts(const simulation_map *map, xoshiro_lanes *g, uint16_t *results, const int rounds) {
+	const double scale = map->scale;
+	uint64_t x[1000];
+	uint16_t index[1000];
+	uint16_t counts[SIMULATION_HISTOGRAMS][256];
+
+	for (int r = 0; r < rounds; r++) {
+		uint16_t max_count = 0;
+		int near = 0;
+
+		fill_u64(g, x, 1000);
+
+		#pragma omp simd reduction(|:near)
+		for (int j = 0; j < 1000; j++) {
+			const int t = (int)((double)(int64_t)(x[j] >> 11) * scale);
+
+			index[j] = (uint16_t)t;
+			near |= ((double)(int64_t)(x[j] >> 11) * scale - t < SIMULATION_MARGIN) | ((double)(int64_t)(x[j] >> 11) * scale - t > 1.0 - SIMULATION_MARGIN);
+		}
+
+		if (near) {
+			for (int j = 0; j < 1000; j++) index[j] = (uint16_t)floor(((x[j] >> 11) * 1.1102230246251565e-16) / map->p);
+		}
+
+		memset(counts, 0, sizeof(counts));
+		for (int j = 0; j < 1000; j += SIMULATION_HISTOGRAMS) {
+			counts[0][index[j]]++;
+			counts[1][index[j + 1]]++;
+			counts[2][index[j + 2]]++;
+			counts[3][index[j + 3]]++;
+		}
+
+		#pragma omp simd reduction(max:max_count)
+		for (int j = 0; j < map->k_effective; j++) {
+			const uint16_t count = counts[0][j] + counts[1][j] + counts[2][j] + counts[3][j];
+			max_count = (count > max_count) ? count : max_count;
+		}
+
+		results[r] = max_count;
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <thread>				// std::thread
+#include <mutex>				// std::mutex
+#include <condition_variable>	// std::condition_variable
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+using namespace std;
+
+void sha256_hash_string(unsigned char *hash, char *outputBuffer) {
+    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+        sprintf(outputBuffer + (i * 2), "%02x", hash[i]);
+    }
+}
+
+// Hashes data in a background thread while the caller keeps loading / translating.
+// At most one submitted buffer is in flight: submit() blocks until the previous buffer has been
+// hashed, so a caller alternating between two buffers (a double buffer) can fill one while the
+// other is being hashed. A buffer must not be modified until the next submit() (or wait()) returns.
+class sha256_pipeline {
+	EVP_MD_CTX *mdctx;
+	bool failed;
+
+	mutex lock;
+	condition_variable cv;
+	const uint8_t *pending;
+	size_t pendingLen;
+	bool busy;
+	bool done;
+	thread worker;
+
+	void run() {
+		unique_lock<mutex> guard(lock);
+
+		while(true) {
+			cv.wait(guard, [this]{ return busy || done; });
+			if(!busy) break;
+
+			// Hash outside of the lock so that the producer can keep going.
+			guard.unlock();
+			if(!failed && (EVP_DigestUpdate(mdctx, pending, pendingLen) != 1)) failed = true;
+			guard.lock();
+
+			busy = false;
+			cv.notify_all();
+		}
+	}
+
+	void stop() {
+		{
+			unique_lock<mutex> guard(lock);
+			cv.wait(guard, [this]{ return !busy; });
+			done = true;
+			cv.notify_all();
+		}
+		if(worker.joinable()) worker.join();
+	}
+
+public:
+	sha256_pipeline() : mdctx(NULL), failed(false), pending(NULL), pendingLen(0), busy(false), done(false) {
+		// In this call, we implicitly fetch the SHA256 algorithm automatically from the relevant API
+		if(((mdctx = EVP_MD_CTX_new()) == NULL) || (EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL) != 1)) {
+			fprintf(stderr, "Can't setup a SHA256 context.\n");
+			failed = true;
+		}
+		worker = thread(&sha256_pipeline::run, this);
+	}
+
+	~sha256_pipeline() {
+		stop();
+		if(mdctx != NULL) EVP_MD_CTX_free(mdctx);
+	}
+
+	void submit(const uint8_t *buf, size_t len) {
+		if(len == 0) return;
+
+		unique_lock<mutex> guard(lock);
+		cv.wait(guard, [this]{ return !busy; });
+		pending = buf;
+		pendingLen = len;
+		busy = true;
+		cv.notify_all();
+	}
+
+	// Wait until everything submitted so far has been hashed
+	void wait() {
+		unique_lock<mutex> guard(lock);
+		cv.wait(guard, [this]{ return !busy; });
+	}
+
+	// Hash any remaining data and write the digest as a hex string (2*SHA256_DIGEST_LENGTH+1 bytes)
+	bool finish(char *outputBuffer) {
+		unsigned char digest[SHA256_DIGEST_LENGTH];
+
+		stop();
+		outputBuffer[0] = '\0';
+		if(failed || (EVP_DigestFinal_ex(mdctx, digest, NULL) != 1)) {
+			fprintf(stderr, "Can't finalize the hash.\n");
+			return false;
+		}
+
+		sha256_hash_string(digest, outputBuffer);
+		return true;
+	}
+};
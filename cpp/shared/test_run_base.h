@@ -26,7 +26,7 @@ protected:
         baseJson["type"] = type;
         baseJson["toolVersion"] = VERSION;
 
-        if (errorLevel != 0){
+        if ((errorLevel != 0) || !errorMsg.empty()){
             baseJson["errorMessage"] = errorMsg;
         }
         if(!filename.empty()) {
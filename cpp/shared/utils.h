@@ -18,11 +18,17 @@
 #include <array>		// std::array
 #include <omp.h>		// openmp 4.0 with gcc 4.9
 #include <bitset>
-#include <mutex>		// std::mutex
 #include <assert.h>
 #include <cfloat>
 #include <math.h>
+#include <fcntl.h>		// open
+#include <unistd.h>		// close, pread, sysconf
+#include <sys/mman.h>	// mmap, madvise
+#include <sys/stat.h>	// fstat
+#include <errno.h>		// errno
 #include "test_run_base.h"
+#include "sha256_pipeline.h"
+#include "input_stream.h"
 
 #define SWAP(x, y) do { int s = x; x = y; y = s; } while(0)
 #define INOPENINTERVAL(x, a, b) (((a)>(b))?(((x)>(b))&&((x)<(a))):(((x)>(a))&&((x)<(b))))
@@ -51,15 +57,30 @@ typedef unsigned __int128 uint_least128_t;
 # define UINT128_C(N)        ((uint_least128_t)+N ## WBU)
 #endif
 
+// Layout of the samples in the input file
+enum sample_format_t {
+	FORMAT_BYTE = 0,	// one sample per byte, in the least significant bits (the default)
+	FORMAT_PACKED_MSB,	// eight 1-bit samples per byte, most significant bit first
+	FORMAT_PACKED_LSB,	// eight 1-bit samples per byte, least significant bit first
+	FORMAT_NIBBLE		// two 4-bit samples per byte, high nibble first
+};
+
 typedef struct data_t data_t;
 
 struct data_t{
 	int word_size; 		// bits per symbol
+	sample_format_t format; 	// layout of the samples in the input file (set before reading, like word_size)
 	int alph_size; 		// symbol alphabet size
 	uint8_t maxsymbol; 	// the largest symbol present in the raw data stream
 	uint8_t *rawsymbols; 	// raw data words
+	uint8_t *mapping; 	// mmap()ed file window that rawsymbols points into (NULL if rawsymbols is heap allocated)
+	size_t mapping_len; 	// length of the mapped window
+	bool shared_raw; 	// rawsymbols points into the samples of another data set (see read_data_block)
+	uint8_t symbol_table[256]; 	// raw value to (mapped-down) symbol
+	// The following representations are built on first use; use get_symbols(), get_bsymbols() and get_pbsymbols()
 	uint8_t *symbols; 		// data words
 	uint8_t *bsymbols; 	// data words as binary string
+	uint64_t *pbsymbols; 	// data words as binary string, packed 64 bits per word (first bit is the MSB of word 0)
 	long len; 		// number of words in data
 	long blen; 		// number of bits in data
 };
@@ -163,363 +184,872 @@ bool relEpsilonEqual(double A, double B, double maxAbsFactor, double maxRelFacto
 }
 
 
-void free_data(data_t *dp){
-	if(dp->symbols != NULL) free(dp->symbols);
-	if(dp->rawsymbols != NULL) free(dp->rawsymbols);
-	if((dp->word_size > 1) && (dp->bsymbols != NULL)) free(dp->bsymbols);
-} 
+// Number of 64-bit words needed to hold a packed bitstring of the given length
+static inline long packed_words(long bits) {
+	return (bits + 63) / 64;
+}
 
+// Pack the low word_size bits of each symbol (most significant bit first) into the 64-bit words of
+// packed, which must hold packed_words(len*word_size) words. Any unused bits in the last word are set to 0.
+static void pack_symbols(const uint8_t *symbols, long len, int word_size, uint64_t *packed) {
+	uint64_t acc = 0;
+	int accbits = 0;
+	long i, k = 0;
+
+	if(word_size == 8) {
+		// Whole bytes: eight symbols form a word
+		for(i = 0; i + 8 <= len; i += 8, k++) {
+			acc = 0;
+			for(int j = 0; j < 8; j++) acc = (acc << 8) | symbols[i+j];
+			packed[k] = acc;
+		}
+		acc = 0;
+		for(; i < len; i++, accbits += 8) acc = (acc << 8) | symbols[i];
+	} else {
+		uint8_t mask = (uint8_t)((1U << word_size) - 1);
+
+		for(i = 0; i < len; i++) {
+			uint8_t sym = symbols[i] & mask;
+
+			if(accbits + word_size <= 64) {
+				acc = (acc << word_size) | sym;
+				accbits += word_size;
+				if(accbits == 64) {
+					packed[k++] = acc;
+					acc = 0;
+					accbits = 0;
+				}
+			} else {
+				// The symbol straddles two words
+				int spill = accbits + word_size - 64;
+				packed[k++] = (acc << (word_size - spill)) | (sym >> spill);
+				acc = sym & ((1U << spill) - 1);
+				accbits = spill;
+			}
+		}
+	}
 
-// Read in binary file to test
-bool read_file_subset(const char *file_path, data_t *dp, unsigned long subsetIndex, unsigned long subsetSize, TestRunBase *testRun) {
+	if(accbits > 0) packed[k] = acc << (64 - accbits);
+}
 
-	FILE *file; 
-	int mask, j, max_symbols;
-	long rc, i;
-	long fileLen;
+// Extract n bits (1 <= n <= 64) starting at bit position pos of a packed bitstring, with the first bit
+// as the most significant bit of the result.
+static inline uint64_t packed_bits(const uint64_t *p, long pos, int n) {
+	long k = pos >> 6;
+	int off = (int)(pos & 63);
+	uint64_t hi = p[k] << off;
 
-	file = fopen(file_path, "rb");
-	if(!file){
-                testRun->errorLevel = -1;
-                testRun->errorMsg = "Error: could not open '%s'\n", file_path;
-		printf("Error: could not open '%s'\n", file_path);
-		return false;
+	if(off + n > 64) hi |= p[k+1] >> (64 - off);
+
+	return hi >> (64 - n);
+}
+
+// Count the ones in bits [start, start+len) of a packed bitstring
+static long packed_popcount(const uint64_t *p, long start, long len) {
+	long count = 0;
+	long k, lastk;
+	int off;
+
+	if(len <= 0) return 0;
+
+	k = start >> 6;
+	off = (int)(start & 63);
+	lastk = (start + len - 1) >> 6;
+
+	if(k == lastk) return __builtin_popcountll((p[k] << off) >> (64 - len));
+
+	count = __builtin_popcountll(p[k] << off);
+	for(k++; k < lastk; k++) count += __builtin_popcountll(p[k]);
+	count += __builtin_popcountll(p[lastk] >> (63 - ((start + len - 1) & 63)));
+
+	return count;
+}
+
+// Number of samples handled together by the parallel translation passes. This is a multiple of 64, so that
+// each block of the packed bitstring starts on a word boundary (whatever the word size).
+#define TRANSLATE_BLOCK 65536
+
+// Establish (or check) the word size and the symbol alphabet of rawsymbols
+// This takes one parallel pass over rawsymbols, which finds which raw values are present (with per-thread
+// presence tables). That determines the data mask, the word size and the map-down table (symbol_table). The
+// symbols, bsymbols and pbsymbols representations are only built when they are first used (see get_symbols,
+// get_bsymbols and get_pbsymbols), as most tools only need some of them.
+static bool translate_data(data_t *dp, TestRunBase *testRun) {
+	int mask, max_symbols;
+	long i;
+	uint8_t datamask = 0;
+	uint8_t curbit = 0x80;
+	bool rawPresent[256];
+
+	dp->symbols = NULL;
+	dp->bsymbols = NULL;
+	dp->pbsymbols = NULL;
+
+	memset(rawPresent, 0, sizeof(rawPresent));
+
+	#pragma omp parallel
+	{
+		bool localPresent[256];
+
+		memset(localPresent, 0, sizeof(localPresent));
+
+		#pragma omp for schedule(static) nowait
+		for(i = 0; i < dp->len; i++) localPresent[dp->rawsymbols[i]] = true;
+
+		#pragma omp critical(presenceMerge)
+		for(int v = 0; v < 256; v++) rawPresent[v] = rawPresent[v] || localPresent[v];
 	}
 
-	rc = (long)fseek(file, 0, SEEK_END);
-	if(rc < 0) {
-    testRun->errorLevel = -1;
-    testRun->errorMsg = "Error: fseek failed";
-    printf("Error: fseek failed\n");
-		fclose(file);
-		return false;
+	for(int v = 0; v < 256; v++) {
+		if(rawPresent[v]) datamask = datamask | (uint8_t)v;
+	}
+
+	for(i=8; (i>0) && ((datamask & curbit) == 0); i--) {
+		curbit = curbit >> 1;
 	}
 
-	fileLen = ftell(file);
-	if(fileLen < 0){
-    testRun->errorLevel = -1;
-    testRun->errorMsg = "Error: ftell failed";
-    printf("Error: ftell failed\n");
-		fclose(file);
+	//Do we need to establish the word size?
+	if(dp->word_size == 0) {
+		//Yes. Establish the word size using the highest order bit in use
+		dp->word_size = i;
+	} else if( i < dp->word_size ) {
+		printf("Warning: Symbols appear to be narrower than described.\n");
+		testRun->errorMsg = "Warning: Symbols appear to be narrower than described.";
+	} else if( i > dp->word_size ) {
+		testRun->errorLevel = -1;
+		testRun->errorMsg = "Error: Incorrect bit width specification: Data (" + std::to_string(i) + ") does not fit within described bit width: " + std::to_string(dp->word_size) + ".";
+		printf("Incorrect bit width specification: Data (%ld) does not fit within described bit width: %d.\n",i,dp->word_size);
 		return false;
 	}
 
-	rewind(file);
+	max_symbols = 1 << dp->word_size;
+	int symbol_map_down_table[max_symbols];
 
-	if(subsetSize == 0) {
-		dp->len = fileLen;
-	} else {
-		rc = (long)fseek(file, subsetIndex*subsetSize, SEEK_SET);
-		if(rc < 0){
-                        testRun->errorLevel = -1;
-                        testRun->errorMsg = "Error: fseek failed";
-			printf("Error: fseek failed\n");
-			fclose(file);
-			return false;
+	// find the symbols (samples) that are present, and check if they need to be mapped down
+	dp->maxsymbol = 0;
+	dp->alph_size = 0;
+	memset(symbol_map_down_table, 0, max_symbols*sizeof(int));
+	mask = max_symbols-1;
+	for(int v = 0; v < 256; v++){
+		if(rawPresent[v]) {
+			symbol_map_down_table[v & mask] = 1;
+			if((v & mask) > dp->maxsymbol) dp->maxsymbol = v & mask;
 		}
+	}
 
-		dp->len = min(fileLen - subsetIndex*subsetSize, subsetSize);
+	for(i = 0; i < max_symbols; i++){
+		if(symbol_map_down_table[i] != 0) symbol_map_down_table[i] = (uint8_t)dp->alph_size++;
 	}
 
-	if(dp->len == 0){
-    testRun->errorLevel = -1;
-    testRun->errorMsg = "Error: '%s' is empty\n", file_path;
-    printf("Error: '%s' is empty\n", file_path);
-		fclose(file);
-		return false;
+	// map down symbols if less than 2^bits_per_word unique symbols
+	for(int v = 0; v < 256; v++){
+		if(dp->alph_size < dp->maxsymbol + 1) dp->symbol_table[v] = (uint8_t)symbol_map_down_table[v & mask];
+		else dp->symbol_table[v] = (uint8_t)(v & mask);
 	}
 
-	dp->symbols = (uint8_t*)malloc(sizeof(uint8_t)*dp->len);
-	dp->rawsymbols = (uint8_t*)malloc(sizeof(uint8_t)*dp->len);
-	if((dp->symbols == NULL) || (dp->rawsymbols == NULL)){
-    testRun->errorLevel = -1;
-    testRun->errorMsg = "Error: failure to initialize memory for symbols";
-    printf("Error: failure to initialize memory for symbols\n");
-		fclose(file);
-		if(dp->symbols != NULL) {
-			free(dp->symbols);
-			dp->symbols = NULL;
-		}
-		if(dp->rawsymbols != NULL) {
-			free(dp->rawsymbols);
-			dp->rawsymbols = NULL;
-		}
-		return false;
+	// the bitstrings use the non-mapped data
+	dp->blen = dp->len * dp->word_size;
+
+	return true;
+}
+
+// Number of samples that hold the (possibly truncated) bitstring of blen bits
+static inline long bitstring_samples(const data_t *dp) {
+	return min(dp->len, (dp->blen + dp->word_size - 1) / dp->word_size);
+}
+
+// The representations are built on first use, so these must not be called concurrently on the same data set
+// before the representation exists (build it first, e.g. before starting tasks that share the data set).
+// They return NULL if the representation can't be allocated; build_views() reports that through the test run.
+
+// The (mapped-down) symbols
+uint8_t *get_symbols(data_t *dp) {
+	if(dp->symbols != NULL) return dp->symbols;
+
+	dp->symbols = (uint8_t*)malloc(sizeof(uint8_t)*max(dp->len, 1L));
+	if(dp->symbols == NULL) return NULL;
+
+	long nblocks = (dp->len + TRANSLATE_BLOCK - 1) / TRANSLATE_BLOCK;
+
+	#pragma omp parallel for schedule(static)
+	for(long b = 0; b < nblocks; b++){
+		long start = b*TRANSLATE_BLOCK;
+		long end = min(start + TRANSLATE_BLOCK, dp->len);
+
+		for(long k = start; k < end; k++) dp->symbols[k] = dp->symbol_table[dp->rawsymbols[k]];
 	}
 
-	rc = fread(dp->symbols, sizeof(uint8_t), dp->len, file);
-	if(rc != dp->len){
-    testRun->errorLevel = -1;
-    testRun->errorMsg = "Error: file read failure";
-    printf("Error: file read failure\n");
-		fclose(file);
-		free(dp->symbols);
-		dp->symbols = NULL;
-		free(dp->rawsymbols);
-		dp->rawsymbols = NULL;
-		return false;
+	return dp->symbols;
+}
+
+// The bitstring (one bit per byte, the most significant bit of each sample first), covering the first blen bits.
+// For 1-bit samples, this is the same buffer as the symbols.
+uint8_t *get_bsymbols(data_t *dp) {
+	uint8_t bitTable[256][8];
+	long nsamples, nblocks;
+	int mask;
+
+	if(dp->bsymbols != NULL) return dp->bsymbols;
+
+	if(dp->word_size == 1) {
+		dp->bsymbols = get_symbols(dp);
+		return dp->bsymbols;
 	}
-	fclose(file);
 
-	//Do we need to establish the word size?
-	if(dp->word_size == 0) {
-		uint8_t datamask = 0;
-		uint8_t curbit = 0x80;
+	nsamples = bitstring_samples(dp);
+	dp->bsymbols = (uint8_t*)malloc(max(nsamples * dp->word_size, 1L));
+	if(dp->bsymbols == NULL) return NULL;
 
-		for(i = 0; i < dp->len; i++) {
-			datamask = datamask | dp->symbols[i];
+	// bits of each (non-mapped) symbol, most significant bit first
+	mask = (1 << dp->word_size) - 1;
+	for(int v = 0; v < 256; v++){
+		for(int j = 0; j < 8; j++){
+			bitTable[v][j] = (j < dp->word_size) ? (((v & mask) >> (dp->word_size-1-j)) & 0x1) : 0;
 		}
+	}
 
-		for(i=8; (i>0) && ((datamask & curbit) == 0); i--) {
-			curbit = curbit >> 1;
-		}
+	nblocks = (nsamples + TRANSLATE_BLOCK - 1) / TRANSLATE_BLOCK;
 
-		dp->word_size = i;
-	} else {
-		uint8_t datamask = 0;
-		uint8_t curbit = 0x80;
+	#pragma omp parallel for schedule(static)
+	for(long b = 0; b < nblocks; b++){
+		long start = b*TRANSLATE_BLOCK;
+		long end = min(start + TRANSLATE_BLOCK, nsamples);
+		const uint8_t *raw = dp->rawsymbols;
 
-		for(i = 0; i < dp->len; i++) {
-			datamask = datamask | dp->symbols[i];
+		if(dp->word_size == 8) {
+			for(long k = start; k < end; k++) memcpy(dp->bsymbols + 8*k, bitTable[raw[k]], 8);
+		} else {
+			for(long k = start; k < end; k++) memcpy(dp->bsymbols + k*dp->word_size, bitTable[raw[k]], dp->word_size);
 		}
+	}
 
-		for(i=8; (i>0) && ((datamask & curbit) == 0); i--) {
-			curbit = curbit >> 1;
+	return dp->bsymbols;
+}
+
+// The bitstring packed 64 bits per word, covering (at least) the first blen bits
+uint64_t *get_pbsymbols(data_t *dp) {
+	long nsamples, nblocks;
+
+	if(dp->pbsymbols != NULL) return dp->pbsymbols;
+
+	nsamples = bitstring_samples(dp);
+	dp->pbsymbols = (uint64_t*)malloc(sizeof(uint64_t)*max(packed_words(nsamples * dp->word_size), 1L));
+	if(dp->pbsymbols == NULL) return NULL;
+
+	nblocks = (nsamples + TRANSLATE_BLOCK - 1) / TRANSLATE_BLOCK;
+
+	#pragma omp parallel for schedule(static)
+	for(long b = 0; b < nblocks; b++){
+		long start = b*TRANSLATE_BLOCK;
+		long end = min(start + TRANSLATE_BLOCK, nsamples);
+
+		// TRANSLATE_BLOCK*word_size bits is a whole number of words
+		pack_symbols(dp->rawsymbols + start, end - start, dp->word_size, dp->pbsymbols + (start*dp->word_size)/64);
+	}
+
+	return dp->pbsymbols;
+}
+
+// Representations of a data set, for build_views()
+#define VIEW_SYMBOLS 0x1
+#define VIEW_BSYMBOLS 0x2
+#define VIEW_PBSYMBOLS 0x4
+
+// Build the given representations (once blen is final) before the assessment starts, so that an allocation
+// failure is reported through testRun rather than ending the program. Returns false (with the error message in
+// testRun, for the caller to print) if one of them couldn't be built.
+bool build_views(data_t *dp, int views, TestRunBase *testRun) {
+	const char *failed = NULL;
+
+	if((views & VIEW_SYMBOLS) && (get_symbols(dp) == NULL)) failed = "symbols";
+	else if((views & VIEW_BSYMBOLS) && (get_bsymbols(dp) == NULL)) failed = "bsymbols";
+	else if((views & VIEW_PBSYMBOLS) && (get_pbsymbols(dp) == NULL)) failed = "pbsymbols";
+
+	if(failed == NULL) return true;
+
+	testRun->errorLevel = -1;
+	testRun->errorMsg = "Error: failure to initialize memory for " + std::string(failed);
+	return false;
+}
+
+// Drop representations once their last consumer is done; they are rebuilt if they are used again
+void release_symbols(data_t *dp) {
+	// For 1-bit samples, the buffer may still be in use as the bitstring
+	if((dp->symbols != NULL) && (dp->symbols != dp->bsymbols)) free(dp->symbols);
+	dp->symbols = NULL;
+}
+
+void release_bsymbols(data_t *dp) {
+	if((dp->bsymbols != NULL) && (dp->bsymbols != dp->symbols)) free(dp->bsymbols);
+	dp->bsymbols = NULL;
+}
+
+void release_pbsymbols(data_t *dp) {
+	if(dp->pbsymbols != NULL) free(dp->pbsymbols);
+	dp->pbsymbols = NULL;
+}
+
+void free_data(data_t *dp){
+	release_symbols(dp);
+	release_bsymbols(dp);
+	release_pbsymbols(dp);
+	if(dp->mapping != NULL) munmap(dp->mapping, dp->mapping_len);
+	else if((dp->rawsymbols != NULL) && !dp->shared_raw) free(dp->rawsymbols);
+}
+
+// Parse the argument of the input format option
+bool parse_sample_format(const char *name, sample_format_t *format) {
+	if(strcmp(name, "byte") == 0) *format = FORMAT_BYTE;
+	else if(strcmp(name, "msb") == 0) *format = FORMAT_PACKED_MSB;
+	else if(strcmp(name, "lsb") == 0) *format = FORMAT_PACKED_LSB;
+	else if(strcmp(name, "nibble") == 0) *format = FORMAT_NIBBLE;
+	else return false;
+
+	return true;
+}
+
+static inline int samples_per_byte(sample_format_t format) {
+	switch(format) {
+		case FORMAT_PACKED_MSB:
+		case FORMAT_PACKED_LSB:
+			return 8;
+		case FORMAT_NIBBLE:
+			return 2;
+		default:
+			return 1;
+	}
+}
+
+// Width of the samples that the input format can hold
+static inline int format_sample_bits(sample_format_t format) {
+	return 8 / samples_per_byte(format);
+}
+
+// Unpack nsamples samples, starting with sample number skip of packed, into one sample per byte
+static void unpack_samples(const uint8_t *packed, long skip, long nsamples, sample_format_t format, uint8_t *out) {
+	const int spb = samples_per_byte(format);
+	const int bits = 8 / spb;
+	const uint8_t mask = (uint8_t)((1U << bits) - 1);
+	long i = 0, byte;
+
+	// Leading samples up to the first byte boundary
+	for(; (i < nsamples) && (((skip + i) % spb) != 0); i++) {
+		long s = skip + i;
+		int pos = (int)(s % spb);
+		if(format == FORMAT_PACKED_LSB) out[i] = (packed[s / spb] >> pos) & mask;
+		else out[i] = (packed[s / spb] >> (8 - bits*(pos+1))) & mask;
+	}
+
+	byte = (skip + i) / spb;
+
+	if(format == FORMAT_NIBBLE) {
+		for(; i + 2 <= nsamples; i += 2, byte++) {
+			out[i] = packed[byte] >> 4;
+			out[i+1] = packed[byte] & 0x0F;
 		}
+	} else {
+		// Each byte expands to eight samples, taken from a 256 entry table
+		uint8_t table[256][8];
 
-		if( i < dp->word_size ) {
-			printf("Warning: Symbols appear to be narrower than described.\n");
-                        testRun->errorMsg = "Warning: Symbols appear to be narrower than described.";
-		} else if( i > dp->word_size ) {
-                        testRun->errorLevel = -1;
-                        testRun->errorMsg = "Error: Incorrect bit width specification: Data (" + std::to_string(i) + ") does not fit within described bit width: " + std::to_string(dp->word_size) + ".";
-			printf("Incorrect bit width specification: Data (%ld) does not fit within described bit width: %d.\n",i,dp->word_size); 
-                        free(dp->symbols);
-			dp->symbols = NULL;
-			free(dp->rawsymbols);
-			dp->rawsymbols = NULL;
-			return false;
+		for(int b = 0; b < 256; b++) {
+			for(int j = 0; j < 8; j++) {
+				if(format == FORMAT_PACKED_LSB) table[b][j] = (b >> j) & 1;
+				else table[b][j] = (b >> (7 - j)) & 1;
+			}
 		}
+
+		for(; i + 8 <= nsamples; i += 8, byte++) memcpy(out + i, table[packed[byte]], 8);
 	}
 
-	memcpy(dp->rawsymbols, dp->symbols, sizeof(uint8_t)* dp->len);
-	dp->maxsymbol = 0;
+	// Trailing samples of a partial byte
+	for(; i < nsamples; i++) {
+		long s = skip + i;
+		int pos = (int)(s % spb);
+		if(format == FORMAT_PACKED_LSB) out[i] = (packed[s / spb] >> pos) & mask;
+		else out[i] = (packed[s / spb] >> (8 - bits*(pos+1))) & mask;
+	}
+}
 
-	max_symbols = 1 << dp->word_size;
-	int symbol_map_down_table[max_symbols];
+// Release whatever backs rawsymbols (used on the error paths of the readers)
+static void release_rawsymbols(data_t *dp) {
+	if(dp->mapping != NULL) munmap(dp->mapping, dp->mapping_len);
+	else if(dp->rawsymbols != NULL) free(dp->rawsymbols);
+	dp->mapping = NULL;
+	dp->mapping_len = 0;
+	dp->rawsymbols = NULL;
+}
 
-	// create symbols (samples) and check if they need to be mapped down
-	dp->alph_size = 0;
-	memset(symbol_map_down_table, 0, max_symbols*sizeof(int));
-	mask = max_symbols-1;
-	for(i = 0; i < dp->len; i++){ 
-		dp->symbols[i] &= mask;
-		if(dp->symbols[i] > dp->maxsymbol) dp->maxsymbol = dp->symbols[i];
-		if(symbol_map_down_table[dp->symbols[i]] == 0) symbol_map_down_table[dp->symbols[i]] = 1;
-	}
+// Replace the packed bytes in rawsymbols by nsamples unpacked samples (one per byte), starting with sample
+// number skip of the bytes read. The hasher (if any) may still be reading the packed bytes.
+static bool unpack_rawsymbols(data_t *dp, long skip, long nsamples, sha256_pipeline *hasher, TestRunBase *testRun) {
+	uint8_t *unpacked;
 
-	for(i = 0; i < max_symbols; i++){
-		if(symbol_map_down_table[i] != 0) symbol_map_down_table[i] = (uint8_t)dp->alph_size++;
+	unpacked = (uint8_t*)malloc(sizeof(uint8_t)*nsamples);
+	if(unpacked == NULL){
+		testRun->errorLevel = -1;
+		testRun->errorMsg = "Error: failure to initialize memory for symbols";
+		printf("Error: failure to initialize memory for symbols\n");
+		return false;
 	}
 
-	// create bsymbols (bitstring) using the non-mapped data
-	dp->blen = dp->len * dp->word_size;
-	if(dp->word_size == 1) dp->bsymbols = dp->symbols;
-	else{
-		dp->bsymbols = (uint8_t*)malloc(dp->blen);
-		if(dp->bsymbols == NULL){
-			printf("Error: failure to initialize memory for bsymbols\n");
-			free(dp->symbols);
-			dp->symbols = NULL;
-			free(dp->rawsymbols);
-			dp->rawsymbols = NULL;
+	unpack_samples(dp->rawsymbols, skip, nsamples, dp->format, unpacked);
 
-			return false;
+	if(hasher != NULL) hasher->wait();
+	release_rawsymbols(dp);
+	dp->rawsymbols = unpacked;
+	dp->len = nsamples;
+
+	return true;
+}
+
+// Read the stream through two alternating buffers and keep the bytes in [offset, offset + dp->len) in rawsymbols
+// (which must already hold dp->len bytes). If hasher is not NULL, the whole stream is read and each buffer is
+// handed to the hasher while the next one is being read; otherwise reading stops at the end of the window.
+// On return, dp->len is the number of bytes of the window that were actually present.
+static bool stream_file_window(input_stream *in, off_t offset, data_t *dp, sha256_pipeline *hasher) {
+	const long bufSize = 1L << 20;
+	uint8_t *buffers[2];
+	off_t pos = 0;
+	long rc;
+	int cur = 0;
+	bool res = true;
+
+	buffers[0] = new uint8_t[bufSize];
+	buffers[1] = new uint8_t[bufSize];
+
+	while((hasher != NULL) || (pos < offset + (off_t)dp->len)) {
+		rc = in->read(buffers[cur], bufSize);
+		if(rc < 0) {
+			res = false;
+			break;
+		} else if(rc == 0) {
+			break;
 		}
 
-		for(i = 0; i < dp->len; i++){
-			for(j = 0; j < dp->word_size; j++){
-				dp->bsymbols[i*dp->word_size+j] = (dp->symbols[i] >> (dp->word_size-1-j)) & 0x1;
+		// Keep the part of this buffer that overlaps the requested window
+		off_t lo = max(pos, offset);
+		off_t hi = min(pos + (off_t)rc, offset + (off_t)dp->len);
+		if(lo < hi) memcpy(dp->rawsymbols + (lo - offset), buffers[cur] + (lo - pos), hi - lo);
+
+		// This blocks until the other buffer has been hashed, so it is then free to be refilled
+		if(hasher != NULL) hasher->submit(buffers[cur], rc);
+		pos += rc;
+		cur ^= 1;
+	}
+
+	if(hasher != NULL) hasher->wait();
+	delete[] buffers[0];
+	delete[] buffers[1];
+
+	if(pos <= offset) dp->len = 0;
+	else dp->len = min((off_t)dp->len, pos - offset);
+
+	return res;
+}
+
+// Read all of the stream into a growable buffer, which becomes rawsymbols. If hasher is not NULL, each chunk
+// is hashed in the background while the next one is being read.
+static bool read_stream(input_stream *in, data_t *dp, sha256_pipeline *hasher) {
+	size_t cap = 1UL << 20;
+	size_t len = 0;
+	uint8_t *buf, *tmp;
+	long rc;
+
+	buf = (uint8_t*)malloc(cap);
+	if(buf == NULL) return false;
+
+	while(true) {
+		if(len == cap) {
+			// realloc() may move the buffer, so the hasher has to be done with it first
+			if(hasher != NULL) hasher->wait();
+			tmp = (uint8_t*)realloc(buf, 2*cap);
+			if(tmp == NULL) {
+				free(buf);
+				return false;
 			}
+			buf = tmp;
+			cap *= 2;
+		}
+
+		rc = in->read(buf + len, cap - len);
+		if(rc < 0) {
+			if(hasher != NULL) hasher->wait();
+			free(buf);
+			return false;
+		} else if(rc == 0) {
+			break;
 		}
+
+		if(hasher != NULL) hasher->submit(buf + len, rc);
+		len += rc;
 	}
 
-	// map down symbols if less than 2^bits_per_word unique symbols
-	if(dp->alph_size < dp->maxsymbol + 1){
-		for(i = 0; i < dp->len; i++) dp->symbols[i] = (uint8_t)symbol_map_down_table[dp->symbols[i]];
-	} 
+	if(hasher != NULL) hasher->wait();
+	dp->rawsymbols = buf;
+	dp->len = len;
 
 	return true;
 }
 
-bool read_file(const char *file_path, data_t *dp, TestRunBase *testRun){
+// Read the samples from a stream whose length is not known in advance (standard input, or a compressed file),
+// described as name in error messages. The stream is read into a growable buffer; if a subset is requested
+// only that block is kept. The hash (if requested) covers the entire (decompressed) stream.
+// If translate is false, the samples are only unpacked into rawsymbols (see read_file_samples).
+static bool read_stream_subset(input_stream *in, const std::string &name, data_t *dp, unsigned long subsetIndex, unsigned long subsetSize, TestRunBase *testRun, char *hash, bool translate) {
+	const int spb = samples_per_byte(dp->format);
+	sha256_pipeline *hasher = NULL;
+	off_t offset = 0, byteOffset = 0;
+	long nsamples;
+	bool res;
+
+	if(!in->ok()) {
+		testRun->errorLevel = -1;
+		testRun->errorMsg = "Error: can't decode the " + std::string(compression_name(in->compression())) + " data in " + name + ": " + in->error();
+		printf("%s\n", testRun->errorMsg.c_str());
+		return false;
+	}
 
-	FILE *file; 
-	int mask, j, max_symbols;
-	long rc, i;
+	if(hash != NULL) hasher = new sha256_pipeline();
 
-	file = fopen(file_path, "rb");
-	if(!file){
-                testRun->errorLevel = -1;
-                testRun->errorMsg = "Error: could not open '%s'\n", file_path;
-		printf("Error: could not open '%s'\n", file_path);
+	if(subsetSize == 0) {
+		res = read_stream(in, dp, hasher);
+	} else {
+		// Only keep the bytes that hold the requested samples
+		offset = (off_t)(subsetIndex*subsetSize);
+		if(offset < 0) {
+			offset = 0;
+			dp->len = 0;
+		} else {
+			byteOffset = offset / spb;
+			dp->len = (long)((offset + (off_t)subsetSize + spb - 1) / spb - byteOffset);
+		}
+
+		dp->rawsymbols = (uint8_t*)malloc(sizeof(uint8_t)*(dp->len > 0 ? dp->len : 1));
+		if(dp->rawsymbols == NULL){
+			testRun->errorLevel = -1;
+			testRun->errorMsg = "Error: failure to initialize memory for symbols";
+			printf("Error: failure to initialize memory for symbols\n");
+			delete hasher;
+			return false;
+		}
+
+		res = stream_file_window(in, byteOffset, dp, hasher);
+	}
+
+	if(!res){
+		testRun->errorLevel = -1;
+		if(in->error().empty()) testRun->errorMsg = "Error: read failure on " + name;
+		else if(in->compression() == COMPRESSION_NONE) testRun->errorMsg = "Error: read failure on " + name + ": " + in->error();
+		else testRun->errorMsg = "Error: can't decode the " + std::string(compression_name(in->compression())) + " data in " + name + ": " + in->error();
+		printf("%s\n", testRun->errorMsg.c_str());
+		release_rawsymbols(dp);
+		delete hasher;
 		return false;
 	}
 
-	rc = (long)fseek(file, 0, SEEK_END);
-	if(rc < 0){
-                testRun->errorLevel = -1;
-                testRun->errorMsg = "Error: fseek failed";
-		printf("Error: fseek failed\n");
-		fclose(file);
+	// Number of requested samples that were present in the stream
+	nsamples = dp->len * spb - (long)(offset - byteOffset*spb);
+	if(subsetSize != 0) nsamples = min(nsamples, (long)subsetSize);
+
+	if((dp->len == 0) || (nsamples <= 0)){
+		testRun->errorLevel = -1;
+		testRun->errorMsg = "Error: no data in " + name;
+		printf("Error: no data in %s\n", name.c_str());
+		release_rawsymbols(dp);
+		delete hasher;
 		return false;
 	}
 
-	dp->len = ftell(file);
-	if(dp->len < 0){
-                testRun->errorLevel = -1;
-                testRun->errorMsg = "Error: ftell failed";
-		printf("Error: ftell failed\n");
-		fclose(file);
+	if((spb > 1) && !unpack_rawsymbols(dp, (long)(offset - byteOffset*spb), nsamples, hasher, testRun)) {
+		// Stop the hasher before the bytes it reads are released
+		delete hasher;
+		release_rawsymbols(dp);
 		return false;
 	}
 
-	rewind(file);
+	if(translate) res = translate_data(dp, testRun);
 
-	if(dp->len == 0){
-                testRun->errorLevel = -1;
-                testRun->errorMsg = "Error: '%s' is empty\n", file_path;
-		printf("Error: '%s' is empty\n", file_path);
-		fclose(file);
+	if(hasher != NULL) {
+		hasher->finish(hash);
+		delete hasher;
+	}
+
+	if(!res) {
+		release_rawsymbols(dp);
 		return false;
 	}
 
-	dp->symbols = (uint8_t*)malloc(sizeof(uint8_t)*dp->len);
-	dp->rawsymbols = (uint8_t*)malloc(sizeof(uint8_t)*dp->len);
-        if((dp->symbols == NULL) || (dp->rawsymbols == NULL)){
-                testRun->errorLevel = -1;
-                testRun->errorMsg = "Error: failure to initialize memory for symbols";
-                printf("Error: failure to initialize memory for symbols\n");
-                fclose(file);
-                if(dp->symbols != NULL) {
-                        free(dp->symbols);
-                        dp->symbols = NULL;
-                }
-                if(dp->rawsymbols != NULL) {
-                        free(dp->rawsymbols);
-                        dp->rawsymbols = NULL;
-                }
-                return false;
-        }
+	return true;
+}
+
+// Does the decoder accept the start of the file? If not, the decoder's error is left in reason. The file offset
+// is reset for the reader that follows.
+static bool decoder_accepts(int fd, compression_t type, std::string *reason) {
+	uint8_t first;
+	bool res;
 
-	rc = fread(dp->symbols, sizeof(uint8_t), dp->len, file);
-	if(rc != dp->len){
-                testRun->errorLevel = -1;
-                testRun->errorMsg = "Error: file read failure";       
-		printf("Error: file read failure\n");
-		fclose(file);
-		free(dp->symbols);
-		dp->symbols = NULL;
-		free(dp->rawsymbols);
-		dp->rawsymbols = NULL;
+	{
+		input_stream in(fd, type, NULL, 0);
+		res = (in.read(&first, 1) >= 0);
+		*reason = in.error();
+	}
+
+	return (lseek(fd, 0, SEEK_SET) == 0) && res;
+}
+
+// Read the samples from standard input (used for the file name "-"), which may be compressed
+static bool read_stdin_subset(data_t *dp, unsigned long subsetIndex, unsigned long subsetSize, TestRunBase *testRun, char *hash, bool translate) {
+	uint8_t magic[COMPRESSION_MAGIC_LEN];
+	long rc, n = 0;
+
+	// Sniff the format; these bytes are handed back by the input_stream
+	while(n < COMPRESSION_MAGIC_LEN) {
+		rc = read(STDIN_FILENO, magic + n, COMPRESSION_MAGIC_LEN - n);
+		if((rc < 0) && (errno == EINTR)) continue;
+		if(rc <= 0) break;
+		n += rc;
+	}
+
+	input_stream in(STDIN_FILENO, detect_compression(magic, n), magic, n);
+
+	return read_stream_subset(&in, "standard input", dp, subsetIndex, subsetSize, testRun, hash, translate);
+}
+
+// Read in binary file to test
+// The file name "-" reads the samples from standard input (see read_stdin_subset).
+// Files (or standard input) compressed with bzip2, gzip or zstd are recognized by their headers and
+// decompressed while they are read (see read_stream_subset); the hash is then that of the decompressed data.
+// Data that doesn't decode is an error, except for a file with the (short) gzip header that the decoder rejects
+// from the start: raw samples can start with that header, so the file is read as raw samples, with a warning
+// (standard input can't be reread, so there only the header decides).
+// Regular files are mapped read-only, and rawsymbols points directly into the mapped window (only the
+// requested subset is mapped). Only the translated symbols and bsymbols are allocated.
+// If hash is not NULL, the SHA-256 hash of the entire file is computed by a background thread while the
+// data is being translated, and the hex digest is written to hash (2*SHA256_DIGEST_LENGTH+1 bytes).
+// If translate is false, the samples are only unpacked into rawsymbols (see read_file_samples).
+static bool load_file_subset(const char *file_path, data_t *dp, unsigned long subsetIndex, unsigned long subsetSize, TestRunBase *testRun, char *hash, bool translate) {
+
+	int fd;
+	struct stat st;
+	off_t fileLen, offset, byteOffset, mapOffset;
+	size_t mapLen;
+	sha256_pipeline *hasher = NULL;
+	const int spb = samples_per_byte(dp->format);
+	long nsamples;
+	bool res = true;
+
+	dp->symbols = NULL;
+	dp->rawsymbols = NULL;
+	dp->bsymbols = NULL;
+	dp->pbsymbols = NULL;
+	dp->mapping = NULL;
+	dp->mapping_len = 0;
+	dp->shared_raw = false;
+
+	if(hash != NULL) hash[0] = '\0';
+
+	if(dp->word_size > format_sample_bits(dp->format)) {
+		testRun->errorLevel = -1;
+		testRun->errorMsg = "Error: Incorrect bit width specification: the input format holds " + std::to_string(format_sample_bits(dp->format)) + "-bit samples.";
+		printf("Incorrect bit width specification: the input format holds %d-bit samples.\n", format_sample_bits(dp->format));
 		return false;
 	}
-	fclose(file);
 
-	//Do we need to establish the word size?
-	if(dp->word_size == 0) {
-		//Yes. Establish the word size using the highest order bit in use
-		uint8_t datamask = 0;
-		uint8_t curbit = 0x80;
+	if(strcmp(file_path, "-") == 0) return read_stdin_subset(dp, subsetIndex, subsetSize, testRun, hash, translate);
 
-		for(i = 0; i < dp->len; i++) {
-			datamask = datamask | dp->symbols[i];
-		}
+	fd = open(file_path, O_RDONLY);
+	if(fd < 0){
+		testRun->errorLevel = -1;
+		testRun->errorMsg = "Error: could not open '" + std::string(file_path) + "'";
+		printf("Error: could not open '%s'\n", file_path);
+		return false;
+	}
 
-		for(i=8; (i>0) && ((datamask & curbit) == 0); i--) {
-			curbit = curbit >> 1;
-		}
+	if((fstat(fd, &st) < 0) || !S_ISREG(st.st_mode)) {
+		testRun->errorLevel = -1;
+		testRun->errorMsg = "Error: '" + std::string(file_path) + "' is not a regular file";
+		printf("Error: '%s' is not a regular file\n", file_path);
+		close(fd);
+		return false;
+	}
 
-		dp->word_size = i;
-       } else {
-                uint8_t datamask = 0;
-		uint8_t curbit = 0x80;
-
-                for(i = 0; i < dp->len; i++) {
-                        datamask = datamask | dp->symbols[i];
-                }
-
-                for(i=8; (i>0) && ((datamask & curbit) == 0); i--) {
-                        curbit = curbit >> 1;
-                }
-
-                if( i < dp->word_size ) {
-                        printf("Warning: Symbols appear to be narrower than described.\n");
-                        testRun->errorMsg = "Warning: Symbols appear to be narrower than described.";                  
-                } else if( i > dp->word_size ) {
-                        testRun->errorLevel = -1;
-                        testRun->errorMsg = "Error: Incorrect bit width specification: Data (" + std::to_string(i) + ") does not fit within described bit width: " + std::to_string(dp->word_size) + ".";
-			printf("Incorrect bit width specification: Data (%ld) does not fit within described bit width: %d.\n",i,dp->word_size);
-                        free(dp->symbols);
-                        dp->symbols = NULL;
-                        free(dp->rawsymbols);
-                        dp->rawsymbols = NULL;
-                        return false;
-                }
-        }
+	fileLen = st.st_size;
 
+	{
+		uint8_t magic[COMPRESSION_MAGIC_LEN];
+		long n = pread(fd, magic, COMPRESSION_MAGIC_LEN, 0);
+		compression_t type = detect_compression(magic, (n > 0) ? n : 0);
 
-	memcpy(dp->rawsymbols, dp->symbols, sizeof(uint8_t)* dp->len);
-	dp->maxsymbol = 0;
+		std::string reason;
 
-	max_symbols = 1 << dp->word_size;
-	int symbol_map_down_table[max_symbols];
+		if((type == COMPRESSION_GZIP) && !decoder_accepts(fd, type, &reason)) {
+			testRun->errorMsg = "Warning: '" + std::string(file_path) + "' has a gzip header but can't be decoded (" + reason + "); it is assessed as raw samples";
+			printf("%s\n", testRun->errorMsg.c_str());
+		} else if(type != COMPRESSION_NONE) {
+			input_stream in(fd, type, NULL, 0);
 
-	// create symbols (samples) and check if they need to be mapped down
-	dp->alph_size = 0;
-	memset(symbol_map_down_table, 0, max_symbols*sizeof(int));
-	mask = max_symbols-1;
-	for(i = 0; i < dp->len; i++){ 
-		dp->symbols[i] &= mask;
-		if(dp->symbols[i] > dp->maxsymbol) dp->maxsymbol = dp->symbols[i];
-		if(symbol_map_down_table[dp->symbols[i]] == 0) symbol_map_down_table[dp->symbols[i]] = 1;
+			res = read_stream_subset(&in, "'" + std::string(file_path) + "'", dp, subsetIndex, subsetSize, testRun, hash, translate);
+			close(fd);
+			return res;
+		}
 	}
 
-	for(i = 0; i < max_symbols; i++){
-		if(symbol_map_down_table[i] != 0) symbol_map_down_table[i] = (uint8_t)dp->alph_size++;
+	// The subset is counted in samples, which are packed spb to a byte
+	if(subsetSize == 0) {
+		offset = 0;
+		nsamples = fileLen * spb;
+	} else {
+		offset = (off_t)(subsetIndex*subsetSize);
+		if((offset < 0) || (offset >= fileLen * spb)) nsamples = 0;
+		else nsamples = min((unsigned long)(fileLen * spb - offset), subsetSize);
 	}
 
-	// create bsymbols (bitstring) using the non-mapped data
-	dp->blen = dp->len * dp->word_size;
-	if(dp->word_size == 1) dp->bsymbols = dp->symbols;
-	else{
-		dp->bsymbols = (uint8_t*)malloc(dp->blen);
-		if(dp->bsymbols == NULL){
-                        testRun->errorLevel = -1;
-                        testRun->errorMsg = "Error: failure to initialize memory for bsymbols";
-			printf("Error: failure to initialize memory for bsymbols\n");
-                        free(dp->symbols);
-			dp->symbols = NULL;
-			free(dp->rawsymbols);
-			dp->rawsymbols = NULL;
+	// The bytes holding the requested samples
+	byteOffset = offset / spb;
+	dp->len = (long)((offset + nsamples + spb - 1) / spb - byteOffset);
+
+	if(dp->len == 0){
+		testRun->errorLevel = -1;
+		testRun->errorMsg = "Error: '" + std::string(file_path) + "' is empty";
+		printf("Error: '%s' is empty\n", file_path);
+		close(fd);
+		return false;
+	}
+
+	if(hash != NULL) {
+		// The whole file has to be read for the hash, so map all of it.
+		hasher = new sha256_pipeline();
+		mapOffset = 0;
+		mapLen = (size_t)fileLen;
+	} else {
+		// mmap() offsets must be page aligned, so map from the page containing the first requested byte
+		mapOffset = byteOffset - (byteOffset % sysconf(_SC_PAGESIZE));
+		mapLen = (size_t)(byteOffset - mapOffset) + (size_t)dp->len;
+	}
+
+	dp->mapping = (uint8_t*)mmap(NULL, mapLen, PROT_READ, MAP_PRIVATE, fd, mapOffset);
+	if(dp->mapping == MAP_FAILED) {
+		long rc, i;
+
+		// Fall back to reading the window into memory
+		dp->mapping = NULL;
+		dp->rawsymbols = (uint8_t*)malloc(sizeof(uint8_t)*dp->len);
+		if(dp->rawsymbols == NULL){
+			testRun->errorLevel = -1;
+			testRun->errorMsg = "Error: failure to initialize memory for symbols";
+			printf("Error: failure to initialize memory for symbols\n");
+			close(fd);
+			delete hasher;
 			return false;
 		}
 
-		for(i = 0; i < dp->len; i++){
-			for(j = 0; j < dp->word_size; j++){
-				dp->bsymbols[i*dp->word_size+j] = (dp->symbols[i] >> (dp->word_size-1-j)) & 0x1;
+		if(hasher != NULL) {
+			input_stream in(fd, COMPRESSION_NONE, NULL, 0);
+			long expected = dp->len;
+			res = stream_file_window(&in, byteOffset, dp, hasher) && (dp->len == expected);
+		} else {
+			for(i = 0; i < dp->len; i += rc) {
+				rc = pread(fd, dp->rawsymbols + i, dp->len - i, byteOffset + i);
+				if(rc <= 0) break;
 			}
+			res = (i >= dp->len);
 		}
+
+		if(!res){
+			testRun->errorLevel = -1;
+			testRun->errorMsg = "Error: file read failure";
+			printf("Error: file read failure\n");
+			close(fd);
+			release_rawsymbols(dp);
+			delete hasher;
+			return false;
+		}
+	} else {
+		dp->mapping_len = mapLen;
+		dp->rawsymbols = dp->mapping + (byteOffset - mapOffset);
+
+		// The translation passes read the window front to back. Huge pages are only available for
+		// file mappings on some kernels / filesystems, so failure here is not an error.
+		madvise(dp->mapping, dp->mapping_len, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+		madvise(dp->mapping, dp->mapping_len, MADV_HUGEPAGE);
+#endif
+
+		// Hash the mapping in the background while the symbols are translated
+		if(hasher != NULL) hasher->submit(dp->mapping, dp->mapping_len);
 	}
+	close(fd);
 
-	// map down symbols if less than 2^bits_per_word unique symbols
-	if(dp->alph_size < dp->maxsymbol + 1){
-		for(i = 0; i < dp->len; i++) dp->symbols[i] = (uint8_t)symbol_map_down_table[dp->symbols[i]];
-	} 
+	if((spb > 1) && !unpack_rawsymbols(dp, (long)(offset - byteOffset*spb), nsamples, hasher, testRun)) {
+		// Stop the hasher before the bytes it reads are released
+		delete hasher;
+		release_rawsymbols(dp);
+		return false;
+	}
+
+	if(translate) res = translate_data(dp, testRun);
+
+	if(hasher != NULL) {
+		hasher->finish(hash);
+		delete hasher;
+	}
+
+	if(!res) {
+		release_rawsymbols(dp);
+		return false;
+	}
 
 	return true;
 }
 
+bool read_file_subset(const char *file_path, data_t *dp, unsigned long subsetIndex, unsigned long subsetSize, TestRunBase *testRun, char *hash = NULL) {
+	return load_file_subset(file_path, dp, subsetIndex, subsetSize, testRun, hash, true);
+}
+
+bool read_file(const char *file_path, data_t *dp, TestRunBase *testRun, char *hash = NULL){
+	return read_file_subset(file_path, dp, 0, 0, testRun, hash);
+}
+
+// Read all the samples of a file without translating them, so that blocks of it can be translated separately
+// (see read_data_block). rawsymbols then holds one sample per byte (whatever the input format), and len is the
+// number of samples. The word size isn't established or checked. Release with free_data().
+bool read_file_samples(const char *file_path, data_t *dp, TestRunBase *testRun, char *hash = NULL){
+	return load_file_subset(file_path, dp, 0, 0, testRun, hash, false);
+}
+
+// Translate the subsetIndex-th block of subsetSize samples of the samples read by read_file_samples into block,
+// whose word_size must be set as for reading. This produces the same data set as read_file_subset() with the
+// same subset, without reading the file again. Different blocks can be set up concurrently.
+bool read_data_block(const data_t *samples, data_t *block, unsigned long subsetIndex, unsigned long subsetSize, TestRunBase *testRun){
+	unsigned long offset = subsetIndex*subsetSize;
+	bool res;
+
+	block->symbols = NULL;
+	block->bsymbols = NULL;
+	block->pbsymbols = NULL;
+	block->mapping = NULL;
+	block->mapping_len = 0;
+	block->format = samples->format;
+	block->shared_raw = true;
+
+	if((subsetSize == 0) || (offset >= (unsigned long)samples->len)) {
+		testRun->errorLevel = -1;
+		testRun->errorMsg = "Error: no data in block " + std::to_string(subsetIndex);
+		printf("Error: no data in block %lu\n", subsetIndex);
+		block->rawsymbols = NULL;
+		return false;
+	}
+
+	// The samples belong to the whole data set, which must outlive the block
+	block->len = (long)min(subsetSize, (unsigned long)samples->len - offset);
+	block->rawsymbols = samples->rawsymbols + offset;
+
+	res = translate_data(block, testRun);
+	if(!res) block->rawsymbols = NULL;
+
+	return res;
+}
+
 /* This is xoshiro256** 1.0*/
 /*This implementation is derived from David Blackman and Sebastiano Vigna, which they placed into
 the public domain. See http://xoshiro.di.unimi.it/xoshiro256starstar.c
@@ -550,12 +1080,14 @@ static inline uint64_t xoshiro256starstar(uint64_t *xoshiro256starstarState)
    non-overlapping subsequences for parallel computations. */
 void xoshiro_jump(unsigned int jump_count, uint64_t *xoshiro256starstarState) {
 	static const uint64_t JUMP[] = { 0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c };
-	uint64_t s0 = 0;
-	uint64_t s1 = 0;
-	uint64_t s2 = 0;
-	uint64_t s3 = 0;
 
 	for(unsigned int j=0; j < jump_count; j++) {
+		// Each jump starts from its own (zero) accumulators
+		uint64_t s0 = 0;
+		uint64_t s1 = 0;
+		uint64_t s2 = 0;
+		uint64_t s3 = 0;
+
 		for(unsigned int i = 0; i < sizeof JUMP / sizeof *JUMP; i++)
 			for(unsigned int b = 0; b < 64; b++) {
 				if (JUMP[i] & ((uint64_t)1) << b) {
@@ -651,16 +1183,211 @@ double randomUnit(uint64_t *xoshiro256starstarState) {
 	return((xoshiro256starstar(xoshiro256starstarState) >> 11) * 1.1102230246251565e-16);
 }
 
+// Number of interleaved xoshiro256** generators in a xoshiro_lanes
+#define XOSHIRO_LANES 8
+
+// XOSHIRO_LANES xoshiro256** generators that are stepped together, so that each word of their states is held (for all
+// the lanes) in vector registers. Each step of the lanes gives XOSHIRO_LANES outputs, one per lane in lane order. The
+// outputs of the last step that haven't been used yet are kept in buf.
+struct alignas(64) xoshiro_lanes {
+	uint64_t s[4][XOSHIRO_LANES];
+	uint64_t buf[XOSHIRO_LANES];
+	unsigned int used;		// number of entries of buf that have been used
+};
+
+// Seeds the lanes of stream number stream (e.g., a thread number) from a main state. Lane l of the stream starts
+// stream * XOSHIRO_LANES + l jumps (see xoshiro_jump) after the main state, so no two lanes of any streams overlap.
+void xoshiro_lanes_seed(xoshiro_lanes *g, const uint64_t *xoshiro256starstarMainState, const unsigned int stream) {
+	uint64_t xoshiro256starstarState[4];
+
+	memcpy(xoshiro256starstarState, xoshiro256starstarMainState, sizeof(xoshiro256starstarState));
+	xoshiro_jump(stream * XOSHIRO_LANES, xoshiro256starstarState);
+
+	for (int l = 0; l < XOSHIRO_LANES; l++) {
+		for (int k = 0; k < 4; k++) g->s[k][l] = xoshiro256starstarState[k];
+		xoshiro_jump(1, xoshiro256starstarState);
+	}
+
+	g->used = XOSHIRO_LANES;
+}
+
+// Steps the lanes blocks times, writing the XOSHIRO_LANES outputs of each step to out
+static inline void xoshiro_lanes_blocks(xoshiro_lanes *g, uint64_t *out, const size_t blocks) {
+	uint64_t s0[XOSHIRO_LANES], s1[XOSHIRO_LANES], s2[XOSHIRO_LANES], s3[XOSHIRO_LANES];
+
+	// Local copies, which the compiler can keep in registers (out may alias g)
+	memcpy(s0, g->s[0], sizeof(s0));
+	memcpy(s1, g->s[1], sizeof(s1));
+	memcpy(s2, g->s[2], sizeof(s2));
+	memcpy(s3, g->s[3], sizeof(s3));
+
+	for (size_t b = 0; b < blocks; b++) {
+		#pragma omp simd
+		for (int l = 0; l < XOSHIRO_LANES; l++) {
+			const uint64_t t = s1[l] << 17;
+
+			out[b * XOSHIRO_LANES + l] = rotl(s1[l] * 5, 7) * 9;
+
+			s2[l] ^= s0[l];
+			s3[l] ^= s1[l];
+			s1[l] ^= s2[l];
+			s0[l] ^= s3[l];
+
+			s2[l] ^= t;
+
+			s3[l] = rotl(s3[l], 45);
+		}
+	}
+
+	memcpy(g->s[0], s0, sizeof(s0));
+	memcpy(g->s[1], s1, sizeof(s1));
+	memcpy(g->s[2], s2, sizeof(s2));
+	memcpy(g->s[3], s3, sizeof(s3));
+}
+
+// One output of the lanes
+static inline uint64_t xoshiro_lanes_u64(xoshiro_lanes *g) {
+	if (g->used == XOSHIRO_LANES) {
+		xoshiro_lanes_blocks(g, g->buf, 1);
+		g->used = 0;
+	}
+
+	return g->buf[g->used++];
+}
+
+// Writes the next n outputs of the lanes to out
+void fill_u64(xoshiro_lanes *g, uint64_t *out, const size_t n) {
+	size_t i = 0, blocks;
+
+	// First, what is left of the last step
+	while ((i < n) && (g->used < XOSHIRO_LANES)) out[i++] = g->buf[g->used++];
+
+	blocks = (n - i) / XOSHIRO_LANES;
+	xoshiro_lanes_blocks(g, out + i, blocks);
+	i += blocks * XOSHIRO_LANES;
+
+	while (i < n) out[i++] = xoshiro_lanes_u64(g);
+}
+
+// Fills out with n doubles uniformly distributed in [0, 1), as randomUnit does
+void fill_unit_double(xoshiro_lanes *g, double *out, const size_t n) {
+	uint64_t x[256];
+
+	for (size_t i = 0; i < n; i += 256) {
+		const size_t m = min((size_t)256, n - i);
+
+		fill_u64(g, x, m);
+
+		#pragma omp simd
+		for (size_t j = 0; j < m; j++) out[i + j] = (double)(x[j] >> 11) * 1.1102230246251565e-16;
+	}
+}
+
+// Maps the output x of the lanes to an integer uniformly distributed in [0, s], as randomRange64 does; the rejected
+// outputs are replaced by the next outputs of the lanes
+static inline uint64_t bounded_u64(uint64_t x, uint64_t s, xoshiro_lanes *g) {
+	uint128_t m;
+
+	if (UINT64_MAX == s) return x;
+
+	s++; // We want an integer in the range [0,s], not [0,s)
+	m = (uint128_t)x * (uint128_t)s;
+
+	if ((uint64_t)m < s) {
+		uint64_t t = ((uint64_t)(-s)) % s;
+		while ((uint64_t)m < t) m = (uint128_t)xoshiro_lanes_u64(g) * (uint128_t)s;
+	}
+
+	return (uint64_t)(m >> 64U);
+}
+
+// Fills out with n integers uniformly distributed in [0, s]
+void fill_bounded(xoshiro_lanes *g, uint64_t *out, const size_t n, const uint64_t s) {
+	fill_u64(g, out, n);
+	for (size_t i = 0; i < n; i++) out[i] = bounded_u64(out[i], s, g);
+}
+
+// Number of random indices drawn ahead of the swaps in FYshuffle
+#define SHUFFLE_BATCH 64
+
 // Fisher-Yates Fast (in place) shuffle algorithm
-void FYshuffle(uint8_t data[], uint8_t rawdata[], const int sample_size, uint64_t *xoshiro256starstarState) {
-	long int r;
-	static mutex shuffle_mutex;
-	unique_lock<mutex> lock(shuffle_mutex);
+// The only state is the caller's (per-thread) RNG lanes, so any number of threads can shuffle concurrently.
+// The random words are filled, and mapped to bounded indices, in batches ahead of the swaps, so that the RNG
+// arithmetic isn't interleaved with the cache misses of the swaps, and the swapped entries can be prefetched.
+void FYshuffle(uint8_t data[], uint8_t rawdata[], const int sample_size, xoshiro_lanes *g) {
+	uint64_t x[SHUFFLE_BATCH];
+	long int r[SHUFFLE_BATCH];
+	long int i, j, n;
+
+	for (i = sample_size - 1; i > 0; i -= n) {
+		n = min((long int)SHUFFLE_BATCH, i);
+		fill_u64(g, x, n);
+
+		for (j = 0; j < n; j++) {
+			r[j] = (long int)bounded_u64(x[j], (uint64_t)(i - j), g);
+			__builtin_prefetch(data + r[j], 1);
+			__builtin_prefetch(rawdata + r[j], 1);
+		}
+
+		for (j = 0; j < n; j++) {
+			SWAP(data[r[j]], data[i - j]);
+			SWAP(rawdata[r[j]], rawdata[i - j]);
+		}
+	}
+}
+
+// The same shuffle as FYshuffle, of n bits packed in 64 bit words (bit i is bit i%64 of bits[i/64])
+// For the same RNG state, the bits end up in the same order as the entries of data in FYshuffle.
+void FYshuffle_bits(uint64_t bits[], const long int n, xoshiro_lanes *g) {
+	uint64_t x[SHUFFLE_BATCH];
+	long int r[SHUFFLE_BATCH];
+	long int i, j, m;
+	// The word holding bit i - j, which every swap changes, is kept in top
+	long int cur = (n - 1) >> 6;
+	uint64_t top;
+
+	if (n < 2) return;
+	top = bits[cur];
+
+	for (i = n - 1; i > 0; i -= m) {
+		m = min((long int)SHUFFLE_BATCH, i);
+		fill_u64(g, x, m);
+
+		for (j = 0; j < m; j++) {
+			r[j] = (long int)bounded_u64(x[j], (uint64_t)(i - j), g);
+			__builtin_prefetch(bits + (r[j] >> 6), 1);
+		}
+
+		for (j = 0; j < m; j++) {
+			const long int a = r[j], b = i - j;
+			uint64_t d;
+
+			if ((b >> 6) != cur) {
+				bits[cur] = top;
+				cur = b >> 6;
+				top = bits[cur];
+			}
+
+			if ((a >> 6) == cur) {
+				d = ((top >> (a & 63)) ^ (top >> (b & 63))) & 1;
+				top ^= (d << (a & 63)) | (d << (b & 63));
+			} else {
+				d = ((bits[a >> 6] >> (a & 63)) ^ (top >> (b & 63))) & 1;
+				bits[a >> 6] ^= d << (a & 63);
+				top ^= d << (b & 63);
+			}
+		}
+	}
+
+	bits[cur] = top;
+}
 
-	for (long int i = sample_size - 1; i > 0; --i) {
-		r = (long int)randomRange64((uint64_t)i, xoshiro256starstarState);
-		SWAP(data[r], data[i]);
-		SWAP(rawdata[r], rawdata[i]);
+// Packs n binary (0 or 1) symbols into 64 bit words, as used by FYshuffle_bits
+void pack_bits(const uint8_t symbols[], const long int n, uint64_t bits[]) {
+	for (long int w = 0; w < (n + 63) / 64; w++) {
+		uint64_t word = 0;
+		for (long int k = 0; (k < 64) && (64*w + k < n); k++) word |= (uint64_t)(symbols[64*w + k] & 1) << k;
+		bits[w] = word;
 	}
 }
 
@@ -696,16 +1423,26 @@ T sum(const vector<T> &v) {
 	return sum;
 }
 
+// Symbol at position pos of the sorted symbols, given the number of occurrences of each symbol
+static int sorted_symbol_at(const long counts[256], long pos) {
+	int v;
+
+	for(v = 0; (v < 255) && (pos >= counts[v]); v++) pos -= counts[v];
+
+	return v;
+}
+
 // Calculate baseline statistics
 // Finds mean, median, and whether or not the data is binary
 void calc_stats(const data_t *dp, double &rawmean, double &median) {
+	long counts[256];
 
 	// Calculate mean
 	rawmean = sum(dp->rawsymbols, dp->len) / (double)dp->len;
 
-	// Sort in a vector for median/min/max
-	vector<uint8_t> v(dp->symbols, dp->symbols + dp->len);
-	sort(v.begin(), v.end());
+	// The median only depends on the number of occurrences of each symbol, so the symbols needn't be sorted
+	memset(counts, 0, sizeof(counts));
+	for(long i = 0; i < dp->len; i++) counts[dp->symbol_table[dp->rawsymbols[i]]]++;
 
 	long int half = dp->len / 2;
 	if(dp->alph_size == 2) {
@@ -715,10 +1452,10 @@ void calc_stats(const data_t *dp, double &rawmean, double &median) {
 	} else {
 		if((dp->len & 1) == 1) {
 			//the length is odd
-			median = v[half];
+			median = sorted_symbol_at(counts, half);
 		} else {
 			//the length is even
-			median = (v[half] + v[half - 1]) / 2.0;
+			median = (sorted_symbol_at(counts, half) + sorted_symbol_at(counts, half - 1)) / 2.0;
 		}
 	}
 }
@@ -1020,6 +1757,14 @@ static void printVersion(string name) {
     cout << "\n\n";
 }
 
+// Accept "--stdin" as a synonym for the file name "-" (read the samples from standard input).
+// This has to be done before getopt() sees the arguments.
+static void translateStdinOption(int argc, char* argv[]) {
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--stdin") == 0) argv[i] = (char*)"-";
+    }
+}
+
 static string recreateCommandLine(int argc, char* argv[]) {
     string commandLine = "";
     for(int i = 0; i < argc; ++i) {
@@ -15,10 +15,12 @@
 
 
 [[ noreturn ]] void print_usage() {
-    printf("Usage is: ea_transpose [-v] [-l <index>] <file> <outfile>\n");
+    printf("Usage is: ea_transpose [-v] [-l <index>] [-f <format>] <file> <outfile>\n");
     printf("\t [-v]: Increase verbosity.\n");
     printf("\t [-l <index>]\t Read the <index> substring of 1000000 samples.\n");
+    printf("\t [-f <format>]\t Layout of the samples: 'byte' (default), 'msb' or 'lsb' (8 bits per byte), or 'nibble' (2 samples per byte).\n");
     printf("\t <file>: File with (blocks of) 1000 sets of restart data, each set being 1000 samples.\n");
+    printf("\t Use '-' or '--stdin' to read the restart data from standard input.\n");
     printf("\t The result is saved in <file>.column\n");
     printf("\t This program computes the transpose of the restart matrix, and produces column data appropriate testing with the other tools.\n");
     printf("\t This helps to support the testing described in SP800-90B Section 3.1.2 #3\n");
@@ -40,6 +42,9 @@ int main(int argc, char* argv[]) {
     FILE *fp;
 
     data.word_size = 0;
+    data.format = FORMAT_BYTE;
+
+    translateStdinOption(argc, argv);
 
     for (int i = 0; i < argc; i++) {
         std::string Str = std::string(argv[i]);
@@ -48,7 +53,7 @@ int main(int argc, char* argv[]) {
             exit(0);
         }
     }
-    while ((opt = getopt(argc, argv, "vl:")) != -1) {
+    while ((opt = getopt(argc, argv, "vl:f:")) != -1) {
         switch (opt) {
             case 'v':
                 verbose++;
@@ -61,6 +66,9 @@ int main(int argc, char* argv[]) {
                 subsetIndex = inint;
                 subsetSize = r*c;
                 break;
+            case 'f':
+                if (!parse_sample_format(optarg, &data.format)) print_usage();
+                break;
             default:
                 print_usage();
         }